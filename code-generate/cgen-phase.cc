@@ -12,6 +12,7 @@ extern char *out_filename;    // name of output assembly
 extern Program ast_root;             // root of the abstract syntax tree
 extern int omerrs;            // syntax errors
 extern int semant_errors;     // semant errors
+extern int cgen_debug;        // -c, also reports the tree arena
 FILE *fin;       // we read the AST from standard input
 extern int seal_yyparse(void); // entry point to the AST parser
 
@@ -62,6 +63,9 @@ int main(int argc, char *argv[]) {
   } else {
       ast_root->cgen(cout);
   }
+  if (cgen_debug)
+    tree_arena.stats(cout);
+  tree_arena.release();
   fclose(fin);
 }
 
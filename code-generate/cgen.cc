@@ -8,15 +8,45 @@
 
 #include "cgen.h"
 #include "cgen_gc.h"
+#include "cgen_ir.h"
+#include "cgen_regalloc.h"
+#include "cgen_ssa.h"
+#include "cgen_loop.h"
+#include "cgen_peephole.h"
+#include "cgen_writer.h"
 #include <vector>
+#include <sstream>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
 
 using namespace std;
 
 extern void emit_string_constant(ostream& str, char *s);
 extern int cgen_debug;
+extern int cgen_optimize;
+extern int cgen_unroll_factor;
+extern int cgen_unroll_trips;
+extern bool disable_reg_alloc;
 
 static char *CALL_REGS[] = {RDI, RSI, RDX, RCX, R8, R9};
-static char *CALL_XMM[] = {XMM0, XMM1, XMM2, XMM3};
+static char *CALL_XMM[] = {XMM0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7};
+#define CALL_REGS_COUNT 6
+#define CALL_XMM_COUNT 8
+
+// registers handed out by the allocator; the argument registers, %rax and
+// %rdx are left alone as scratch
+static const char *GPR_CALLEE[] = {RBX, R12, R13, R14, R15};
+static const char *GPR_CALLER[] = {R10, R11};
+static const char *XMM_CALLER[] = {XMM8, XMM9, XMM10, XMM11, XMM12, XMM13, XMM14, XMM15};
+
+// a leaf makes no calls, so the argument registers that carry no para are
+// free for it as well
+static const char *GPR_LEAF[] = {RDI, RSI, RCX, R8, R9};
+static const char *XMM_LEAF[] = {XMM2, XMM3, XMM4, XMM5, XMM6, XMM7};
+
+// bytes below %rsp a leaf may use without moving %rsp
+#define RED_ZONE 128
 
 void cgen_helper(Decls decls, ostream& s);
 void code(Decls decls, ostream& s);
@@ -28,25 +58,66 @@ void code(Decls decls, ostream& s);
 //  
 //
 //////////////////////////////////////////////////////////////////
-// variable name - memory
-typedef SymbolTable<Symbol, int> variableTable;
-variableTable variabletab;
 // function - offset
 typedef std::map<Symbol, int> functionTable;
 
 int offset = 0;
-int tempaddress = 0;
 int labelNum = 0;
-int continuePos = 0;
-int breakPos = 0;
+
+// callee-saved registers the function being coded writes, in the order
+// they are saved; the first one lands at -8(%rbp)
+static std::vector<const char *> saved_regs;
+// the function being coded sets up no frame at all
+static bool frameless = false;
+
+// rewrites each function's code under -O
+static Peephole peephole;
+// functions whose calls loops may hoist under -O
+static std::set<Symbol> pure_functions;
+
+//
+// Where a virtual register of the function being coded lives.  Spilled
+// values start out as NONE until layout_frame gives them a stack slot.
+// An IMM is an immediate operand of the three-address code.
+//
+struct Location {
+  enum Kind { NONE, UNUSED, REG, FRAME, STATIC, IMM };
+  Kind kind;
+  const char *reg;
+  int offset;
+  Symbol global;
+  long long value;
+
+  Location() : kind(NONE), reg(NULL), offset(0), global(NULL), value(0) {}
+};
+
+static std::vector<Location> locations;   // indexed by vreg
+
+static ostream& operator<<(ostream& s, const Location& l)
+{
+  switch (l.kind) {
+  case Location::REG:
+    return s << l.reg;
+  case Location::FRAME:
+    return s << decimal(l.offset) << "(" << RBP << ")";
+  case Location::STATIC:
+    return s << l.global << "(" << RIP << ")";
+  case Location::IMM:
+    return s << "$" << decimal(l.value);
+  default:
+    assert(0 && "value has no location");
+  }
+  return s;
+}
+
 // you can add any helper functions here
 static void emit_mrmovsd(const char *base_reg,int offset, const char *dest, ostream& s)
 {
-  s << MOVSD << offset << "(" << base_reg << ")" << COMMA << dest << endl;
+  s << MOVSD << decimal(offset) << "(" << base_reg << ")" << COMMA << dest << '\n';
 }
 static void emit_rmmovsd(const char *base_reg,int offset, const char *dest, ostream& s)
 {
-  s << MOVSD << base_reg << COMMA << offset << "(" << dest<< ")" << endl;
+  s << MOVSD << base_reg << COMMA << decimal(offset) << "(" << dest<< ")" << '\n';
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -93,8 +164,11 @@ static void initialize_constants(void)
 //
 //*********************************************************
 
-void Program_class::cgen(ostream &os) 
+void Program_class::cgen(ostream &out) 
 {
+  AsmWriter writer(out.rdbuf());
+  ostream os(&writer);
+
   // spim wants comments to start with '#'
   os << "# start of generated code\n";
 
@@ -102,6 +176,8 @@ void Program_class::cgen(ostream &os)
   cgen_helper(decls,os);
 
   os << "\n# end of generated code\n";
+  writer.flush();
+  out.flush();
 }
 
 
@@ -121,247 +197,516 @@ void Program_class::cgen(ostream &os)
 
 static void emit_mov(const char *source, const char *dest, ostream& s)
 {
-  s << MOV << source << COMMA << dest << endl;
+  s << MOV << source << COMMA << dest << '\n';
 }
 
 static void emit_rmmov(const char *source_reg, int offset, const char *base_reg, ostream& s)
 {
-  s << MOV << source_reg << COMMA << offset << "(" << base_reg << ")"
-      << endl;
+  s << MOV << source_reg << COMMA << decimal(offset) << "(" << base_reg << ")"
+      << '\n';
 }
 
 static void emit_mrmov(const char *base_reg, int offset, const char *dest_reg, ostream& s)
 {
-  s << MOV << offset << "(" << base_reg << ")" << COMMA << dest_reg  
-      << endl;
+  s << MOV << decimal(offset) << "(" << base_reg << ")" << COMMA << dest_reg  
+      << '\n';
 }
 
 static void emit_irmov(const char *immidiate, const char *dest_reg, ostream& s)
 {
   s << MOV << "$" << immidiate << COMMA << dest_reg  
-      << endl;
+      << '\n';
 }
 
 static void emit_irmovl(const char *immidiate, const char *dest_reg, ostream& s)
 {
   s << MOVL << "$" << immidiate << COMMA << dest_reg  
-      << endl;
+      << '\n';
 }
 
 static void emit_immov(const char *immidiate, int offset, const char *base_reg, ostream& s)
 {
-  s << MOV << "$" << immidiate << COMMA << "(" << offset << ")" << base_reg  
-      << endl;
+  s << MOV << "$" << immidiate << COMMA << "(" << decimal(offset) << ")" << base_reg  
+      << '\n';
 }
 
 static void emit_add(const char *source_reg, const char *dest_reg, ostream& s)
 {
-  s << ADD << source_reg << COMMA << dest_reg << endl;
+  s << ADD << source_reg << COMMA << dest_reg << '\n';
 }
 
 static void emit_sub(const char *source_reg, const char *dest_reg, ostream& s)
 {
-  s << SUB << source_reg << COMMA << dest_reg << endl;
+  s << SUB << source_reg << COMMA << dest_reg << '\n';
 }
 
 static void emit_mul(const char *source_reg, const char *dest_reg, ostream& s)
 {
-  s << MUL << source_reg << COMMA << dest_reg << endl;
+  s << MUL << source_reg << COMMA << dest_reg << '\n';
 }
 
 static void emit_div(const char *dest_reg, ostream& s)
 {
-  s << DIV << dest_reg << endl;
+  s << DIV << dest_reg << '\n';
 }
 
 static void emit_cqto(ostream &s)
 {
-  s << CQTO << endl;
+  s << CQTO << '\n';
 }
 
 static void emit_neg(const char *dest_reg, ostream& s)
 {
-  s << NEG << dest_reg << endl;
+  s << NEG << dest_reg << '\n';
 }
 
 static void emit_and(const char *source_reg, const char *dest_reg, ostream& s)
 {
-  s << AND << source_reg << COMMA << dest_reg << endl;
+  s << AND << source_reg << COMMA << dest_reg << '\n';
 }
 
 static void emit_or(const char *source_reg, const char *dest_reg, ostream& s)
 {
-  s << OR << source_reg << COMMA << dest_reg << endl;
+  s << OR << source_reg << COMMA << dest_reg << '\n';
 }
 
 static void emit_xor(const char *source_reg, const char *dest_reg, ostream& s)
 {
-  s << XOR << source_reg << COMMA << dest_reg << endl;
+  s << XOR << source_reg << COMMA << dest_reg << '\n';
 }
 
 static void emit_not(const char *dest_reg, ostream& s)
 {
-  s << NOT << " " << dest_reg << endl;
+  s << NOT << " " << dest_reg << '\n';
 }
 
 static void emit_movsd(const char *source, const char *dest, ostream& s)
 {
-  s << MOVSD << source << COMMA << dest << endl;
+  s << MOVSD << source << COMMA << dest << '\n';
 }
 
 static void emit_movaps(const char *source, const char *dest, ostream& s)
 {
-  s << MOVAPS << source << COMMA << dest << endl;
+  s << MOVAPS << source << COMMA << dest << '\n';
 }
 
 static void emit_addsd(const char *source_reg, const char *dest_reg, ostream& s)
 {
-  s << ADDSD << source_reg << COMMA << dest_reg << endl;
+  s << ADDSD << source_reg << COMMA << dest_reg << '\n';
 }
 
 static void emit_subsd(const char *source_reg, const char *dest_reg, ostream& s)
 {
-  s << SUBSD << source_reg << COMMA << dest_reg << endl;
+  s << SUBSD << source_reg << COMMA << dest_reg << '\n';
 }
 
 static void emit_mulsd(const char *source_reg, const char *dest_reg, ostream& s)
 {
-  s << MULSD << source_reg << COMMA << dest_reg << endl;
+  s << MULSD << source_reg << COMMA << dest_reg << '\n';
 }
 
 static void emit_divsd(const char *source_reg, const char *dest_reg, ostream& s)
 {
-  s << DIVSD << source_reg << COMMA << dest_reg << endl;
+  s << DIVSD << source_reg << COMMA << dest_reg << '\n';
 }
 
 static void emit_cmp(const char *source_reg, const char *dest_reg, ostream& s)
 {
-  s << CMP << source_reg << COMMA << dest_reg << endl;
+  s << CMP << source_reg << COMMA << dest_reg << '\n';
 }
 
 static void emit_test(const char *source_reg, const char *dest_reg, ostream& s)
 {
-  s << TEST << source_reg << COMMA << dest_reg << endl;
+  s << TEST << source_reg << COMMA << dest_reg << '\n';
 }
 
 static void emit_ucompisd(const char *source_reg, const char *dest_reg, ostream& s)
 {
-  s << UCOMPISD << source_reg << COMMA << dest_reg << endl;
+  s << UCOMPISD << source_reg << COMMA << dest_reg << '\n';
 }
 
 static void emit_xorpd(const char *source_reg, const char *dest_reg, ostream& s)
 {
-  s << XORPD << source_reg << COMMA << dest_reg << endl;
+  s << XORPD << source_reg << COMMA << dest_reg << '\n';
 }
 static void emit_jmp(const char *dest, ostream& s)
 {
-  s << JMP << " " << dest << endl;
+  s << JMP << " " << dest << '\n';
 }
 
 static void emit_jl(const char *dest, ostream& s)
 {
-  s << JL << " " << dest << endl;
+  s << JL << " " << dest << '\n';
 }
 
 static void emit_jle(const char *dest, ostream& s)
 {
-  s << JLE << " " << dest << endl;
+  s << JLE << " " << dest << '\n';
 }
 
 static void emit_je(const char *dest, ostream& s)
 {
-  s << JE << " " << dest << endl;
+  s << JE << " " << dest << '\n';
 }
 
 static void emit_jne(const char *dest, ostream& s)
 {
-  s << JNE << " " << dest << endl;
+  s << JNE << " " << dest << '\n';
 }
 
 static void emit_jg(const char *dest, ostream& s)
 {
-  s << JG << " " << dest << endl;
+  s << JG << " " << dest << '\n';
 }
 
 static void emit_jge(const char *dest, ostream& s)
 {
-  s << JGE << " " << dest << endl;
+  s << JGE << " " << dest << '\n';
 }
 
 static void emit_jb(const char *dest, ostream& s)
 {
-  s << JB << " " << dest << endl;
+  s << JB << " " << dest << '\n';
 }
 
 static void emit_jbe(const char *dest, ostream& s)
 {
-  s << JBE << " " << dest << endl;
+  s << JBE << " " << dest << '\n';
 }
 
 static void emit_ja(const char *dest, ostream& s)
 {
-  s << JA << " " << dest << endl;
+  s << JA << " " << dest << '\n';
 }
 
 static void emit_jae(const char *dest, ostream& s)
 {
-  s << JAE << " " << dest << endl;
+  s << JAE << " " << dest << '\n';
 }
 
 static void emit_jp(const char *dest, ostream& s)
 {
-  s << JP << " " << dest << endl;
+  s << JP << " " << dest << '\n';
 }
 
 static void emit_jz(const char *dest, ostream& s)
 {
-  s << JZ << " " << dest << endl;
+  s << JZ << " " << dest << '\n';
 }
 
 static void emit_jnz(const char *dest, ostream& s)
 {
-  s << JNZ << " " << dest << endl;
+  s << JNZ << " " << dest << '\n';
 }
 
 static void emit_call(const char *dest, ostream& s)
 {
-  s << CALL << " " << dest << endl;
+  s << CALL << " " << dest << '\n';
 }
 
 static void emit_ret(ostream& s)
 {
-  s << RET << endl;
+  s << RET << '\n';
 }
 
 static void emit_push(const char *reg, ostream& s)
 {
-  s << PUSH << " " << reg << endl;
+  s << PUSH << " " << reg << '\n';
 }
 
 static void emit_pop(const char *reg, ostream& s)
 {
-  s << POP << " " << reg << endl;
+  s << POP << " " << reg << '\n';
 }
 
 static void emit_leave(ostream& s)
 {
-  s << LEAVE << endl;
+  s << LEAVE << '\n';
 }
 
 static void emit_position(const char *p, ostream& s)
 {
-  s << p << ":" << endl;
+  s << p << ":" << '\n';
 }
 
 static void emit_float_to_int(const char *float_mmx, const char *int_reg, ostream& s)
 {
-  s << CVTTSD2SIQ << float_mmx << COMMA << int_reg << endl;
+  s << CVTTSD2SIQ << float_mmx << COMMA << int_reg << '\n';
 }
 
 static void emit_int_to_float(const char *int_reg, const char *float_mmx, ostream& s)
 {
-  s << CVTSI2SDQ << int_reg << COMMA << float_mmx << endl;
+  s << CVTSI2SDQ << int_reg << COMMA << float_mmx << '\n';
 }
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Values in registers or stack slots
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static Location reg_loc(const char *reg)
+{
+  Location l;
+  l.kind = Location::REG;
+  l.reg = reg;
+  return l;
+}
+
+// where an operand of the function being coded is, NONE for a missing one
+static Location loc(const Operand &o)
+{
+  if (o.kind == Operand::VREG)
+    return locations[o.vreg];
+  Location l;
+  if (o.kind == Operand::IMM) {
+    l.kind = Location::IMM;
+    l.value = o.value;
+  }
+  return l;
+}
+
+static bool same_loc(const Location &a, const Location &b)
+{
+  if (a.kind != b.kind)
+    return false;
+  switch (a.kind) {
+  case Location::REG:    return a.reg == b.reg;
+  case Location::FRAME:  return a.offset == b.offset;
+  case Location::STATIC: return a.global == b.global;
+  case Location::IMM:    return a.value == b.value;
+  default:               return false;
+  }
+}
+
+//
+// copy 8 bytes between two locations, memory to memory goes through %rax
+// and so does an immediate that only a register takes
+//
+static void emit_move(const Location &src, const Location &dst, bool is_float, ostream& s)
+{
+  if (same_loc(src, dst))
+    return;
+  if (src.kind == Location::IMM && !fits_imm(src.value) && dst.kind != Location::REG) {
+    s << MOV << src << COMMA << RAX << '\n';
+    s << MOV << RAX << COMMA << dst << '\n';
+  } else if (src.kind == Location::REG && dst.kind == Location::REG) {
+    s << (is_float ? MOVAPS : MOV) << src << COMMA << dst << '\n';
+  } else if (src.kind == Location::REG || src.kind == Location::IMM ||
+             dst.kind == Location::REG) {
+    s << (is_float ? MOVSD : MOV) << src << COMMA << dst << '\n';
+  } else {
+    s << MOV << src << COMMA << RAX << '\n';
+    s << MOV << RAX << COMMA << dst << '\n';
+  }
+}
+
+static void emit_branch(const char *jump, int pos, ostream& s)
+{
+  s << jump << " " << POSITION << decimal(pos) << '\n';
+}
+
+static void emit_label(int pos, ostream& s)
+{
+  s << POSITION << decimal(pos) << ":" << '\n';
+}
+
+// load the 64-bit pattern of v into the xmm register x
+static void emit_float_bits(double v, const char *x, ostream& s)
+{
+  unsigned long long bits;
+  memcpy(&bits, &v, sizeof(bits));
+  s << MOV << "$0x" << hex << bits << dec << COMMA << RAX << '\n';
+  s << MOV << RAX << COMMA << x << '\n';
+}
+
+//
+// d = a op b for the two-operand integer instructions.  A result that
+// already holds a is updated in place, in memory too; a fresh register
+// gets a sum from leaq and a product by a constant from the three-operand
+// imulq, neither of which needs a copied first.
+//
+static void emit_int_binary(const char *op, Location a, Location b, Location d, ostream& s)
+{
+  bool is_add = strcmp(op, ADD) == 0;
+  bool is_sub = strcmp(op, SUB) == 0;
+  bool is_mul = strcmp(op, MUL) == 0;
+
+  // keep an immediate second and compute in place where possible
+  if (!is_sub && (a.kind == Location::IMM || same_loc(b, d)))
+    std::swap(a, b);
+
+  bool b_simple = b.kind == Location::REG || b.kind == Location::IMM;
+  if (same_loc(a, d) && d.kind != Location::REG && b_simple && !is_mul) {
+    s << op << b << COMMA << d << '\n';
+    return;
+  }
+  if (d.kind == Location::REG && a.kind == Location::REG && !same_loc(a, d) && !same_loc(b, d)) {
+    if (is_add && b.kind == Location::REG) {
+      s << LEA << "(" << a << "," << b << ")" << COMMA << d << '\n';
+      return;
+    }
+    if ((is_add || (is_sub && fits_imm(-b.value))) && b.kind == Location::IMM) {
+      s << LEA << decimal(is_add ? b.value : -b.value) << "(" << a << ")" << COMMA << d << '\n';
+      return;
+    }
+  }
+
+  const char *r = d.kind == Location::REG && !same_loc(b, d) ? d.reg : RAX;
+  if (is_mul && b.kind == Location::IMM && a.kind != Location::IMM) {
+    s << MUL << b << COMMA << a << COMMA << r << '\n';
+  } else {
+    emit_move(a, reg_loc(r), false, s);
+    s << op << b << COMMA << r << '\n';
+  }
+  emit_move(reg_loc(r), d, false, s);
+}
+
+// d = op a for the one-operand integer instructions
+static void emit_int_unary(const char *op, Location a, Location d, ostream& s)
+{
+  const char *r = d.kind == Location::REG ? d.reg : RAX;
+  emit_move(a, reg_loc(r), false, s);
+  s << op << r << '\n';
+  emit_move(reg_loc(r), d, false, s);
+}
+
+// d = a op b in double precision
+static void emit_float_binary(const char *op, Location a, Location b, Location d, ostream& s)
+{
+  const char *x = d.kind == Location::REG && !same_loc(b, d) ? d.reg : XMM0;
+  emit_move(a, reg_loc(x), true, s);
+  s << op << b << COMMA << x << '\n';
+  emit_move(reg_loc(x), d, true, s);
+}
+
+// signed division, result is %rax for the quotient or %rdx for the remainder
+static void emit_int_divide(const char *result, Location a, Location b, Location d, ostream& s)
+{
+  emit_move(a, reg_loc(RAX), false, s);
+  emit_cqto(s);
+  s << DIV << b << '\n';
+  emit_move(reg_loc(result), d, false, s);
+}
+
+// d = a + b*scale + disp
+static void emit_lea(Location a, Location b, int scale, long long disp, Location d, ostream& s)
+{
+  if (a.kind != Location::NONE && a.kind != Location::REG) {
+    emit_move(a, reg_loc(RAX), false, s);
+    a = reg_loc(RAX);
+  }
+  if (b.kind != Location::NONE && b.kind != Location::REG) {
+    emit_move(b, reg_loc(RDX), false, s);
+    b = reg_loc(RDX);
+  }
+  const char *r = d.kind == Location::REG ? d.reg : RAX;
+  s << LEA;
+  if (disp != 0)
+    s << decimal(disp);
+  s << "(";
+  if (a.kind == Location::REG)
+    s << a.reg;
+  if (b.kind == Location::REG)
+    s << "," << b.reg << "," << decimal(scale);
+  s << ")" << COMMA << r << '\n';
+  emit_move(reg_loc(r), d, false, s);
+}
+
+// the relation that holds between the operands when they trade places
+static const Relation SWAPPED[] = {REL_GT, REL_GE, REL_EQ, REL_NE, REL_LE, REL_LT};
+
+//
+// Set the flags for the Int compare of a with b.  cmpq takes at most one
+// memory operand and an immediate only second, so an immediate a swaps
+// the operands; returns whether it did.  A register is tested against 0
+// with testq.
+//
+static bool emit_int_compare(Location a, Location b, ostream& s)
+{
+  bool swapped = a.kind == Location::IMM && b.kind != Location::IMM;
+  if (swapped)
+    std::swap(a, b);
+  if (a.kind == Location::REG && b.kind == Location::IMM && b.value == 0) {
+    emit_test(a.reg, a.reg, s);
+  } else if (a.kind == Location::REG ||
+             (a.kind != Location::IMM && (b.kind == Location::REG || b.kind == Location::IMM))) {
+    s << CMP << b << COMMA << a << '\n';
+  } else {
+    emit_move(a, reg_loc(RAX), false, s);
+    s << CMP << b << COMMA << RAX << '\n';
+  }
+  return swapped;
+}
+
+//
+// Jump to pos when a rel b is jump_if, fall through otherwise.  Floats
+// compare with ucomisd, which sets the flags like an unsigned compare and
+// raises PF when either side is NaN.  Lt and Le swap their operands so
+// that NaN makes every ordered relation false without an extra parity
+// check; only Eq and Ne have to look at PF.
+//
+static void emit_compare_branch(Relation rel, Location a, Location b, bool is_float,
+                                bool jump_if, int pos, ostream& s)
+{
+  static const char *INT_TRUE[] = {JL, JLE, JE, JNE, JGE, JG};
+  static const char *INT_FALSE[] = {JGE, JG, JNE, JE, JL, JLE};
+  static const char *FLOAT_TRUE[] = {JA, JAE, JE, JNE, JAE, JA};
+  static const char *FLOAT_FALSE[] = {JBE, JB, JNE, JE, JB, JBE};
+
+  if (!is_float) {
+    if (emit_int_compare(a, b, s))
+      rel = SWAPPED[rel];
+    emit_branch(jump_if ? INT_TRUE[rel] : INT_FALSE[rel], pos, s);
+    return;
+  }
+
+  if (rel == REL_LT || rel == REL_LE)
+    std::swap(a, b);
+  if (a.kind != Location::REG) {
+    emit_move(a, reg_loc(XMM0), true, s);
+    a = reg_loc(XMM0);
+  }
+  s << UCOMPISD << b << COMMA << a << '\n';
+
+  // unordered means Eq is false and Ne is true
+  bool unordered_jumps = (rel == REL_NE) == jump_if;
+  if ((rel == REL_EQ || rel == REL_NE) && unordered_jumps) {
+    emit_branch(JP, pos, s);
+  } else if (rel == REL_EQ || rel == REL_NE) {
+    int ordered_pos = labelNum ++;
+    emit_branch(JP, ordered_pos, s);
+    emit_branch(jump_if ? FLOAT_TRUE[rel] : FLOAT_FALSE[rel], pos, s);
+    emit_label(ordered_pos, s);
+    return;
+  }
+  emit_branch(jump_if ? FLOAT_TRUE[rel] : FLOAT_FALSE[rel], pos, s);
+}
+
+// d = a rel b as 0 or 1, Ints without a branch
+static void emit_relation(Relation rel, Location a, Location b, bool is_float, Location d, ostream& s)
+{
+  static const char *SETCC[] = {SETL, SETLE, SETE, SETNE, SETGE, SETG};
+
+  if (!is_float) {
+    if (emit_int_compare(a, b, s))
+      rel = SWAPPED[rel];
+    s << SETCC[rel] << AL << '\n';
+    s << MOVZBL << AL << COMMA << EAX << '\n';
+    emit_move(reg_loc(RAX), d, false, s);
+    return;
+  }
+
+  int true_pos = labelNum ++;
+  int end_pos = labelNum ++;
+  emit_compare_branch(rel, a, b, true, true, true_pos, s);
+  s << MOV << "$0" << COMMA << d << '\n';
+  emit_branch(JMP, end_pos, s);
+  emit_label(true_pos, s);
+  s << MOV << "$1" << COMMA << d << '\n';
+  emit_label(end_pos, s);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // coding strings, ints, and booleans
@@ -379,7 +724,7 @@ static void emit_int_to_float(const char *int_reg, const char *float_mmx, ostrea
 //
 void StringEntry::code_ref(ostream& s)
 {
-  s << "$" << STRINGCONST_PREFIX << index;
+  s << "$" << STRINGCONST_PREFIX << decimal(index);
 }
 
 //
@@ -388,7 +733,7 @@ void StringEntry::code_ref(ostream& s)
 
 void StringEntry::code_def(ostream& s)
 {
-  s << STRINGCONST_PREFIX << index << ":" << endl;
+  s << STRINGCONST_PREFIX << decimal(index) << ":" << '\n';
   s  << STRINGTAG ; emit_string_constant(s,str);                                                // align to word
 }
 
@@ -406,7 +751,7 @@ void StrTable::code_string_table(ostream& s)
 // the following 2 functions are useless, please DO NOT care about them
 void FloatEntry::code_ref(ostream &s)
 {
-  s << FLOATTAG << index;
+  s << FLOATTAG << decimal(index);
 }
 
 void IntEntry::code_def(ostream &s)
@@ -421,31 +766,31 @@ void IntEntry::code_def(ostream &s)
 //***************************************************
 
 static void emit_global_int(Symbol name, ostream& s) {
-  s << GLOBAL << name << endl << 
-  ALIGN << 8 << endl << 
-  SYMBOL_TYPE << name << COMMA << OBJECT << endl <<
-  SIZE << name << COMMA << 8 << endl << 
-  name << ":" << endl << 
-  INTTAG << 0 << endl;
+  s << GLOBAL << name << '\n' << 
+  ALIGN << "8" << '\n' << 
+  SYMBOL_TYPE << name << COMMA << OBJECT << '\n' <<
+  SIZE << name << COMMA << "8" << '\n' << 
+  name << ":" << '\n' << 
+  INTTAG << "0" << '\n';
 }
 
 static void emit_global_float(Symbol name, ostream& s) {
-  s << GLOBAL << name << endl << 
-  ALIGN << 8 << endl << 
-  SYMBOL_TYPE << name << COMMA << OBJECT << endl <<
-  SIZE << name << COMMA << 8 << endl << 
-  name << ":" << endl <<
-  FLOATTAG << 0 << endl <<
-  FLOATTAG << 0 << endl;
+  s << GLOBAL << name << '\n' << 
+  ALIGN << "8" << '\n' << 
+  SYMBOL_TYPE << name << COMMA << OBJECT << '\n' <<
+  SIZE << name << COMMA << "8" << '\n' << 
+  name << ":" << '\n' <<
+  FLOATTAG << "0" << '\n' <<
+  FLOATTAG << "0" << '\n';
 }
 
 static void emit_global_bool(Symbol name, ostream& s) {
-  s << GLOBAL << name << endl << 
-  ALIGN << 8 << endl << 
-  SYMBOL_TYPE << name << COMMA << OBJECT << endl <<
-  SIZE << name << COMMA << 8 << endl << 
-  name << ":" << endl << 
-  BOOLTAG << 0 << endl;
+  s << GLOBAL << name << '\n' << 
+  ALIGN << "8" << '\n' << 
+  SYMBOL_TYPE << name << COMMA << OBJECT << '\n' <<
+  SIZE << name << COMMA << "8" << '\n' << 
+  name << ":" << '\n' << 
+  INTTAG << "0" << '\n';
 }
 
 void code_global_data(Decls decls, ostream &str) {
@@ -453,31 +798,66 @@ void code_global_data(Decls decls, ostream &str) {
   for (int i=decls->first(); decls->more(i); i=decls->next(i)) {
     if (!decls->nth(i)->isCallDecl()) {
       count ++;
-      if (count == 1) str<<DATA<<endl;
+      if (count == 1) str<<DATA<<'\n';
       Symbol name = decls->nth(i)->getName();
       Symbol type = decls->nth(i)->getType();
-      if (type == Int) {
+      switch (type_kind(type)) {
+      case TYPE_INT:
         emit_global_int(name, str);
-      } else if (type == Bool) {
+        break;
+      case TYPE_BOOL:
         emit_global_bool(name, str);
-      } else if (type == Float) {
+        break;
+      case TYPE_FLOAT:
         emit_global_float(name, str);
+        break;
+      default:
+        break;
       }
     }
   }
 }
 
+//
+// Under -O, which functions a loop may call in its preheader.  Every
+// function is lowered once to look at it before any is optimized.
+//
+static void find_pure_functions(Decls decls) {
+  std::vector<CallFacts> facts;
+  for (int i=decls->first(); decls->more(i); i=decls->next(i)) {
+    if (!decls->nth(i)->isCallDecl()) {
+      continue;
+    }
+    IrFunction f(decls->nth(i)->getName());
+    ((CallDecl) decls->nth(i))->lower(f);
+    facts.push_back(CallFacts());
+    call_facts(f, facts.back());
+  }
+  find_pure(facts, pure_functions);
+  if (cgen_debug) {
+    cout << "Pure functions:";
+    for (std::set<Symbol>::iterator p = pure_functions.begin(); p != pure_functions.end(); ++p)
+      cout << " " << *p;
+    cout << endl;
+  }
+}
+
 void code_calls(Decls decls, ostream &str) {
-  str<<SECTION<<RODATA<<endl;
+  if (cgen_optimize) {
+    find_pure_functions(decls);
+  }
+  str<<SECTION<<RODATA<<'\n';
   stringtable.code_string_table(str);
-  str<<TEXT<<endl;
+  str<<TEXT<<'\n';
   for (int i=decls->first(); decls->more(i); i=decls->next(i)) {
-    if (decls->nth(i)->isCallDecl()) {
-      if (decls->nth(i)->getName() == Main) {
-        offset = tempaddress = 0;
-      } else {
-        offset = tempaddress = -56;
-      }
+    if (!decls->nth(i)->isCallDecl()) {
+      continue;
+    }
+    if (cgen_optimize) {
+      ostringstream buf;
+      decls->nth(i)->code(buf);
+      peephole.run(buf.str(), str);
+    } else {
       decls->nth(i)->code(str);
     }
   }
@@ -513,6 +893,7 @@ void code(Decls decls, ostream& s)
 
   if (cgen_debug) cout << "Coding calls" << endl;
   code_calls(decls, s);
+  if (cgen_debug && cgen_optimize) peephole.report(cout);
 }
 
 //******************************************************************
@@ -525,947 +906,400 @@ void code(Decls decls, ostream& s)
 //   
 //*****************************************************************
 
-void CallDecl_class::code(ostream &s) {
-  variabletab.enterscope();
-
-  s<<GLOBAL<<name<<endl<<
-  SYMBOL_TYPE<<name<<COMMA<<FUNCTION<<endl;
-
-  s<<name<<":"<<endl;
-  emit_push(RBP, s);
-  emit_mov(RSP, RBP, s);
-  emit_push(RBX, s);
-  emit_push(R10, s);
-  emit_push(R11, s);
-  emit_push(R12, s);
-  emit_push(R13, s);
-  emit_push(R14, s);
-  emit_push(R15, s);  
-
-  // paras
-  int int_num = 0;
-  int float_num = 0;
-  for (int i=paras->first(); paras->more(i); i=paras->next(i)) {
-    Symbol name = paras->nth(i)->getName();
-    Symbol type = paras->nth(i)->getType();
-    if (type == Int || type == Bool) {
-      emit_sub("$8", RSP, s);
-      offset -= 8;
-
-      variabletab.addid(name, new int(offset));
-      s << MOV << CALL_REGS[int_num ++] << COMMA << offset << '(' << RBP << ')'<<endl;
-    } else if (type == Float) {
-      emit_sub("$8", RSP, s);
-      offset -= 8;
-
-      variabletab.addid(name, new int(offset));
-      s << MOV << CALL_XMM[float_num ++] << COMMA << offset << '(' << RBP << ')' <<endl;
-    }
+// append the registers that carry none of the paras to pool
+static void add_free_regs(const char **regs, int n, const std::vector<Location> &args,
+                          std::vector<const char *> &pool)
+{
+  for (int r = 0; r < n; r++) {
+    bool holds_para = false;
+    for (size_t a = 0; a < args.size(); a++)
+      holds_para = holds_para || (args[a].kind == Location::REG && args[a].reg == regs[r]);
+    if (!holds_para)
+      pool.push_back(regs[r]);
   }
-
-  // body
-  body->code(s);
-
-  s<<SIZE<<name<<", "<<".-"<<name<<endl;
-  variabletab.exitscope();
 }
 
-void StmtBlock_class::code(ostream &s){
-  // variable decls
-  for (int i=vars->first(); vars->more(i); i=vars->next(i)) {
-    Symbol name = vars->nth(i)->getName();
+//
+// Run the allocator over the intervals of one function and record where
+// each virtual register lives.  With -r nothing is allocated and every
+// value gets a stack slot, as the code generator always did.  args are
+// where the paras arrive.
+//
+static void allocate_registers(IrFunction &f, IntervalBuilder &b,
+                               const std::vector<Location> &args)
+{
+  std::vector<LiveInterval *> gprs, xmms;
+  locations.assign(b.vregs(), Location());
+  for (int v = 0; v < b.vregs(); v++) {
+    LiveInterval &i = b.interval(v);
+    if (i.fixed) {
+      locations[v].kind = Location::STATIC;
+      locations[v].global = f.global(v);
+    } else if (!i.used()) {
+      locations[v].kind = Location::UNUSED;
+    } else if (!disable_reg_alloc) {
+      (i.is_float ? xmms : gprs).push_back(&i);
+    }
+  }
+  if (disable_reg_alloc)
+    return;
 
-    offset -= 8;
-    variabletab.addid(name, new int(offset));
-    
-    emit_sub("$8", RSP, s);
+  std::vector<const char *> gpr_caller(GPR_CALLER, GPR_CALLER + sizeof(GPR_CALLER) / sizeof(char *));
+  std::vector<const char *> xmm_caller(XMM_CALLER, XMM_CALLER + sizeof(XMM_CALLER) / sizeof(char *));
+  if (b.is_leaf()) {
+    add_free_regs(GPR_LEAF, sizeof(GPR_LEAF) / sizeof(char *), args, gpr_caller);
+    add_free_regs(XMM_LEAF, sizeof(XMM_LEAF) / sizeof(char *), args, xmm_caller);
   }
 
-  for (int i=stmts->first(); stmts->more(i); i=stmts->next(i)) {
-    stmts->nth(i)->code(s);
+  LinearScan gpr_scan(GPR_CALLEE, sizeof(GPR_CALLEE) / sizeof(char *),
+                      &gpr_caller[0], gpr_caller.size());
+  LinearScan xmm_scan(NULL, 0, &xmm_caller[0], xmm_caller.size());
+  gpr_scan.run(gprs);
+  xmm_scan.run(xmms);
+  for (int v = 0; v < b.vregs(); v++) {
+    if (b.interval(v).reg != NULL) {
+      locations[v].kind = Location::REG;
+      locations[v].reg = b.interval(v).reg;
+    }
   }
-}
 
-void IfStmt_class::code(ostream &s) {
-  condition->code(s);
-  emit_mrmov(RBP, tempaddress, RAX, s);
-  emit_test(RAX, RAX, s);
-  int else_pos = labelNum ++;
-  int then_pos = labelNum ++;
-  s<<JZ<<" "<<POSITION<<else_pos<<endl;
-  thenexpr->code(s);
-  s<<JMP<<" "<<POSITION<<then_pos<<endl;
-  s<<POSITION<<else_pos<<":"<<endl;
-  elseexpr->code(s);
-  s<<POSITION<<then_pos<<":"<<endl;
+  if (cgen_debug)
+    cout << "Allocated " << f.name << ": " << gpr_scan.allocated << " of "
+         << gprs.size() << " integer and " << xmm_scan.allocated << " of "
+         << xmms.size() << " float values in registers" << endl;
 }
 
-void WhileStmt_class::code(ostream &s) {
-  int condition_pos = labelNum ++;
-  int end_pos = labelNum ++;
-  continuePos = condition_pos;
-  breakPos = end_pos;
-
-  s<<POSITION<<condition_pos<<":"<<endl;
-  condition->code(s);
-  emit_mrmov(RBP, tempaddress, RAX, s);
-  emit_test(RAX, RAX, s);
-  s<<JZ<<' '<<POSITION<<end_pos<<endl;
-  body->code(s);
-  s<<JMP<<' '<<POSITION<<condition_pos<<endl;
-  s<<POSITION<<end_pos<<":"<<endl;
-}
-
-void ForStmt_class::code(ostream &s) {
-  int condition_pos = labelNum ++;
-  int expr_pos = labelNum ++;
-  int end_pos = labelNum ++;
-  continuePos = expr_pos;
-  breakPos = end_pos;
-
-  initexpr->code(s);
-  s<<POSITION<<condition_pos<<":"<<endl;
-  condition->code(s);
-  emit_mrmov(RBP, tempaddress, RAX, s);
-  emit_test(RAX, RAX, s);
-  s<<JZ<<" "<<POSITION<<end_pos<<endl;
-  body->code(s);
-  s<<POSITION<<expr_pos<<":"<<endl;
-  loopact->code(s);
-  s<<JMP<<" "<<POSITION<<condition_pos<<endl;
-  s<<POSITION<<end_pos<<":"<<endl;
-}
-
-void ReturnStmt_class::code(ostream &s) {
-  value->code(s);
-  if (value->getType()->get_string() == Float->get_string()) {
-    s<<MOVAPS<<tempaddress<<"("<<RBP<<"), "<<XMM0<<endl;
-  } else if (value->getType()->get_string() != Void->get_string()) {
-    emit_mrmov(RBP, tempaddress, RAX, s);
+//
+// Give every spilled value a fixed slot below the saved registers, so the
+// whole frame is known before the first instruction of the body.  Values
+// whose intervals do not overlap share a slot.  Only the callee-saved
+// registers the body writes are saved, and a leaf keeps its slots in the
+// red zone.  Returns how far the prologue has to move %rsp past the saved
+// registers to keep it 16-byte aligned.
+//
+static int layout_frame(Symbol name, IntervalBuilder &b)
+{
+  saved_regs.clear();
+  for (size_t r = 0; r < sizeof(GPR_CALLEE) / sizeof(char *); r++) {
+    for (size_t v = 0; v < locations.size(); v++) {
+      if (locations[v].kind == Location::REG && locations[v].reg == GPR_CALLEE[r]) {
+        saved_regs.push_back(GPR_CALLEE[r]);
+        break;
+      }
+    }
   }
+  offset = -8 * saved_regs.size();
 
-  emit_pop(R15, s);
-  emit_pop(R14, s);
-  emit_pop(R13, s);
-  emit_pop(R12, s);
-  emit_pop(R11, s);
-  emit_pop(R10, s);
-  emit_pop(RBX, s);
-
-  s<<LEAVE<<endl
-  <<RET<<endl;
-}
+  std::vector<LiveInterval *> spilled;
+  bool uses_frame = false;
+  for (size_t v = 0; v < locations.size(); v++) {
+    if (locations[v].kind == Location::NONE) {
+      spilled.push_back(&b.interval(v));
+    }
+    uses_frame = uses_frame || locations[v].kind == Location::FRAME;
+  }
+  int slots = assign_slots(spilled);
+  for (size_t n = 0; n < spilled.size(); n++) {
+    Location &l = locations[spilled[n]->vreg];
+    l.kind = Location::FRAME;
+    l.offset = offset - 8 * (spilled[n]->slot + 1);
+  }
+  offset -= 8 * slots;
 
-void ContinueStmt_class::code(ostream &s) {
-  s<<JMP<<" "<<POSITION<<continuePos<<endl;
+  int frame = (-offset + 15) & ~15;
+  frameless = b.is_leaf() && frame == 0 && !uses_frame;
+  if (cgen_debug)
+    cout << "Frame " << name << ": " << frame << " bytes, " << slots
+         << " slots for " << spilled.size() << " spilled values, "
+         << saved_regs.size() << " saved registers"
+         << (b.is_leaf() ? ", leaf" : "") << endl;
+  if (b.is_leaf() && 8 * slots <= RED_ZONE)
+    return 0;
+  return frame - 8 * saved_regs.size();
 }
 
-void BreakStmt_class::code(ostream &s) {
-  s<<JMP<<" "<<POSITION<<breakPos<<endl;
+static void emit_epilogue(ostream &s)
+{
+  if (!frameless) {
+    for (size_t i = 0; i < saved_regs.size(); i++) {
+      emit_mrmov(RBP, -8 * (i + 1), saved_regs[i], s);
+    }
+    emit_leave(s);
+  }
+  emit_ret(s);
 }
 
-void Call_class::code(ostream &s) {
+static void emit_call_insn(IrFunction &f, IrInsn &in, ostream &s)
+{
   int int_num = 0;
   int float_num = 0;
-  int addr[actuals->len()];
-  int num = 0;
 
-  for (int i=actuals->first(); actuals->more(i); i=actuals->next(i)) {
-    if (actuals->nth(i)->getType()->get_string() == Int->get_string() || actuals->nth(i)->getType()->get_string() == Bool->get_string() || actuals->nth(i)->getType()->get_string() == String->get_string()) {
-      actuals->nth(i)->code(s);
-      addr[i] = tempaddress;
-    }
-
-    if (actuals->nth(i)->getType()->get_string() == Float->get_string()) {
-      num ++;
-      actuals->nth(i)->code(s);
-      addr[i] = tempaddress;
-    }
-  }
-
-  for (int i=actuals->first(); actuals->more(i); i=actuals->next(i)) {
-    if (actuals->nth(i)->getType()->get_string() == Int->get_string() || actuals->nth(i)->getType()->get_string() == Bool->get_string() || actuals->nth(i)->getType()->get_string() == String->get_string()) {
-      s<<MOV<<addr[i]<<"("<<RBP<<")"<<COMMA<<CALL_REGS[int_num ++]<<endl;
-    } else if (actuals->nth(i)->getType()->get_string() == Float->get_string()) {
-      s<<MOVSD<<addr[i]<<"("<<RBP<<")"<<COMMA<<CALL_XMM[float_num ++]<<endl;
+  // arguments never live in the argument registers, so plain moves will do;
+  // whatever does not fit in registers goes on the stack
+  std::vector<Operand> stack_args;
+  for (size_t i = 0; i < in.args.size(); i++) {
+    Operand actual = in.args[i];
+    bool is_float = f.is_float(actual);
+    if (is_float && float_num < CALL_XMM_COUNT) {
+      emit_move(loc(actual), reg_loc(CALL_XMM[float_num ++]), true, s);
+    } else if (!is_float && int_num < CALL_REGS_COUNT) {
+      emit_move(loc(actual), reg_loc(CALL_REGS[int_num ++]), false, s);
+    } else {
+      stack_args.push_back(actual);
     }
   }
 
-  if (name == print) {
-    emit_sub("$8", RSP, s);
-    offset -= 8;
-    s<<MOVL<<"$"<<num<<COMMA<<EAX<<endl;
-    emit_call("printf", s);
-  } else if(type->get_string() == Int->get_string() || type->get_string() == Bool->get_string() || type->get_string() == String->get_string()){
-    emit_call(name->get_string(), s);
+  // the frame keeps %rsp 16-byte aligned, an odd number of stack
+  // arguments needs a pad to keep it that way at the call
+  int stack_bytes = 8 * stack_args.size();
+  if (stack_args.size() % 2 != 0) {
     emit_sub("$8", RSP, s);
-    offset -= 8;
-    tempaddress = offset;
-    emit_rmmov(RAX, offset, RBP, s);
-  } else if (type->get_string() == Float->get_string()) {
-    emit_call(name->get_string(), s);
-    emit_sub("$8", RSP, s);
-    offset -= 8;
-    tempaddress = offset;
-    emit_rmmovsd(XMM0, offset, RBP, s);
+    stack_bytes += 8;
   }
-  //
-  /*
-   if function name is printf
-
-    // please set %eax to the number of Float parameters, num.
-    //  把%eax赋值为Float类型的参数个数, num
-    emit_sub("$8", RSP, s);
-    emit_irmovl(num, EAX, s);
-    emit_call("printf", s);
-      
-    return;
+  for (int i = stack_args.size() - 1; i >= 0; i--) {
+    Location l = loc(stack_args[i]);
+    if (l.kind == Location::REG && f.is_float(stack_args[i])) {
+      emit_sub("$8", RSP, s);
+      s<<MOVSD<<l<<COMMA<<"("<<RSP<<")"<<'\n';
+    } else {
+      s<<PUSH<<" "<<l<<'\n';
+    }
   }
-  */
-  //
-}
-
-void Actual_class::code(ostream &s) {
-  expr->code(s);
-}
-
-void Assign_class::code(ostream &s) {
-  value->code(s);
-  emit_mrmov(RBP, tempaddress, RAX, s);
-  
-  variabletab.enterscope();
-  tempaddress = *variabletab.lookup(lvalue);
-  variabletab.exitscope();
-
-  emit_rmmov(RAX, tempaddress, RBP, s);
-}
-
-void Add_class::code(ostream &s) {
-  e1->code(s);
-  int addr1 = tempaddress;
-  e2->code(s);
-  int addr2 = tempaddress;
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmov(RBP, addr1, RBX, s);
-    emit_mrmov(RBP, addr2, R10, s);
-    emit_add(R10, RBX, s);
-    emit_rmmov(RBX, offset, RBP, s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM4, s);
-    emit_mrmovsd(RBP, addr2, XMM5, s);
-    emit_addsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  } else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmov(RBP, addr1, RBX, s);
-    emit_mrmovsd(RBP, addr2, XMM5, s);
-    emit_int_to_float(RBX, XMM4, s);
-    emit_addsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM4, s);
-    emit_mrmov(RBP, addr2, RBX, s);
-    emit_int_to_float(RBX, XMM5, s);
-    emit_addsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
+  if (in.name == print) {
+    // %al holds the number of vector registers used by the variadic call
+    s<<MOVL<<"$"<<decimal(float_num)<<COMMA<<EAX<<'\n';
   }
-}
-
-void Minus_class::code(ostream &s) {
-  e1->code(s);
-  int addr1 = tempaddress;
-  e2->code(s);
-  int addr2 = tempaddress;
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmov(RBP, addr1, RBX, s);
-    emit_mrmov(RBP, addr2, R10, s);
-    emit_sub(R10, RBX, s);
-    emit_rmmov(RBX, offset, RBP, s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM4, s);
-    emit_mrmovsd(RBP, addr2, XMM5, s);
-    emit_subsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  } else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmov(RBP, addr1, RBX, s);
-    emit_mrmovsd(RBP, addr2, XMM5, s);
-    emit_int_to_float(RBX, XMM4, s);
-    emit_subsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM4, s);
-    emit_mrmov(RBP, addr2, RBX, s);
-    emit_int_to_float(RBX, XMM5, s);
-    emit_subsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
+  emit_call(in.name->get_string(), s);
+  if (stack_bytes > 0) {
+    s<<ADD<<"$"<<decimal(stack_bytes)<<COMMA<<RSP<<'\n';
   }
-}
 
-void Multi_class::code(ostream &s) {
-  e1->code(s);
-  int addr1 = tempaddress;
-  e2->code(s);
-  int addr2 = tempaddress;
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmov(RBP, addr1, RBX, s);
-    emit_mrmov(RBP, addr2, R10, s);
-    emit_mul(R10, RBX, s);
-    emit_rmmov(RBX, offset, RBP, s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM4, s);
-    emit_mrmovsd(RBP, addr2, XMM5, s);
-    emit_mulsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  } else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmov(RBP, addr1, RBX, s);
-    emit_mrmovsd(RBP, addr2, XMM5, s);
-    emit_int_to_float(RBX, XMM4, s);
-    emit_mulsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM4, s);
-    emit_mrmov(RBP, addr2, RBX, s);
-    emit_int_to_float(RBX, XMM5, s);
-    emit_mulsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
+  if (in.dst >= 0 && f.is_float(in.dst)) {
+    emit_move(reg_loc(XMM0), locations[in.dst], true, s);
+  } else if (in.dst >= 0) {
+    emit_move(reg_loc(RAX), locations[in.dst], false, s);
   }
 }
 
-void Divide_class::code(ostream &s) {
-  e1->code(s);
-  int addr1 = tempaddress;
-  e2->code(s);
-  int addr2 = tempaddress;
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmov(RBP, addr1, RAX, s);
-    emit_cqto(s);
-    emit_mrmov(RBP, addr2, RAX, s);
-    emit_div(RBX, s);
-    emit_rmmov(RAX, offset, RBP, s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM4, s);
-    emit_mrmovsd(RBP, addr2, XMM5, s);
-    emit_divsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  } else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmov(RBP, addr1, RBX, s);
-    emit_mrmovsd(RBP, addr2, XMM5, s);
-    emit_int_to_float(RBX, XMM4, s);
-    emit_divsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM4, s);
-    emit_mrmov(RBP, addr2, RBX, s);
-    emit_int_to_float(RBX, XMM5, s);
-    emit_divsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  }
-}
-
-void Mod_class::code(ostream &s) {
-  e1->code(s);
-  int addr1 = tempaddress;
-  e2->code(s);
-  int addr2 = tempaddress;
-  emit_sub("$8", RSP, s); 
-  offset -= 8;
-  tempaddress = offset;
-
-  emit_mrmov(RBP, addr1, RAX, s);
-  emit_cqto(s);
-  emit_mrmov(RBP, addr2, RBX, s);
-  emit_div(RBX, s);
-  emit_rmmov(RDX, offset, RBP, s);
-}
-
-void Neg_class::code(ostream &s) {
-  e1->code(s);
-  int addr1 = tempaddress;
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
-
-  if (e1->getType()->get_string() == Int->get_string()) {
-    emit_mrmov(RBP, addr1, RAX, s);
-    emit_neg(RAX, s);
-    emit_rmmov(RAX, offset, RBP, s);
+//
+// A branch falls through to whichever target comes next, if either does;
+// otherwise it jumps to both.
+//
+static void emit_branch_insn(IrFunction &f, IrInsn &in, IrBlock *next, ostream &s)
+{
+  bool is_float = f.is_float(in.a) || f.is_float(in.b);
+  IrBlock *if_true = in.target[0];
+  IrBlock *if_false = in.target[1];
+  if (if_false == next) {
+    emit_compare_branch(in.rel, loc(in.a), loc(in.b), is_float, true, if_true->label, s);
   } else {
-    emit_sub("$8", RSP, s);
-    emit_mov("$0x8000000000000000",RAX,s);
-    emit_mrmov(RBP,offset,RDX,s);
-    emit_xor(RAX,RDX,s);
-    emit_rmmov(RDX,offset,RBP,s);
+    emit_compare_branch(in.rel, loc(in.a), loc(in.b), is_float, false, if_false->label, s);
+    if (if_true != next)
+      emit_branch(JMP, if_true->label, s);
   }
 }
 
-void Lt_class::code(ostream &s) {
-  e1->code(s);
-  int addr1 = tempaddress;
-  e2->code(s);
-  int addr2 = tempaddress;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmov(RBP,addr1,RAX,s);
-    emit_mrmov(RBP,addr2,RDX,s);
-    emit_cmp(RDX,RAX,s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JL<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0", RAX, s);
-    s<<JMP<<" "<<POSITION<<pos2<<endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,offset,RBP,s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM1, s);
-    emit_mrmov(RBP, addr2, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JB<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0",RAX,s);
-    s<<JMP<<" "<<POSITION<<pos2<< endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,offset,RBP,s);
-  } else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmov(RBP,addr1,RAX,s);
-    emit_int_to_float(RAX,XMM0,s);
-    emit_mrmovsd(RBP,addr2,XMM1,s);
-    emit_ucompisd(XMM0,XMM1,s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JB<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0",RAX,s);
-    s<<JMP<<" "<<POSITION<<pos2<<endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX, 0, RBP, s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM0, s);
-    emit_mrmovsd(RBP, addr2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JB<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0",RAX,s);
-    s<<JMP<<" "<<POSITION<<pos2<<endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,offset,RBP,s);
+static void emit_insn(IrFunction &f, IrInsn &in, IrBlock *next, ostream &s)
+{
+  // by IrOp, for the ones that map to a single instruction
+  static const char *OPCODES[] = {NULL, ADD, SUB, MUL, NULL, NULL, AND, OR, XOR, NEG, NOT,
+                                  ADDSD, SUBSD, MULSD, DIVSD};
+  Location d = in.dst >= 0 ? locations[in.dst] : Location();
+
+  switch (in.op) {
+  case IR_MOV:
+    emit_move(loc(in.a), d, f.is_float(in.a), s);
+    break;
+  case IR_ADD:
+  case IR_SUB:
+  case IR_MUL:
+  case IR_AND:
+  case IR_OR:
+  case IR_XOR:
+    emit_int_binary(OPCODES[in.op], loc(in.a), loc(in.b), d, s);
+    break;
+  case IR_DIV:
+    emit_int_divide(RAX, loc(in.a), loc(in.b), d, s);
+    break;
+  case IR_MOD:
+    emit_int_divide(RDX, loc(in.a), loc(in.b), d, s);
+    break;
+  case IR_NEG:
+  case IR_NOT:
+    emit_int_unary(OPCODES[in.op], loc(in.a), d, s);
+    break;
+  case IR_FADD:
+  case IR_FSUB:
+  case IR_FMUL:
+  case IR_FDIV:
+    emit_float_binary(OPCODES[in.op], loc(in.a), loc(in.b), d, s);
+    break;
+  case IR_FNEG: {
+    const char *x = d.kind == Location::REG ? d.reg : XMM0;
+    emit_move(loc(in.a), reg_loc(x), true, s);
+    emit_mov("$0x8000000000000000", RAX, s);
+    emit_mov(RAX, XMM1, s);
+    emit_xorpd(XMM1, x, s);
+    emit_move(reg_loc(x), d, true, s);
+    break;
   }
-}
-
-void Le_class::code(ostream &s) {
-  e1->code(s);
-  int addr1 = tempaddress;
-  e2->code(s);
-  int addr2 = tempaddress;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmov(RBP,addr1,RAX,s);
-    emit_mrmov(RBP,addr2,RDX,s);
-    emit_cmp(RDX,RAX,s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JLE<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0", RAX, s);
-    s<<JMP<<" "<<POSITION<<pos2<< endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,offset,RBP,s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM1, s);
-    emit_mrmov(RBP, addr2, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JBE<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0",RAX,s);
-    s<<JMP<<" "<<POSITION<<pos2<< endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,offset,RBP,s);
-  } else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmov(RBP,addr1,RAX,s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_mrmovsd(RBP, addr2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JBE<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0",RAX,s);
-    s<<JMP<<" "<<POSITION<<pos2<<endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,0,RBP,s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM0, s);
-    emit_mrmovsd(RBP, addr2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1,s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JBE<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0",RAX,s);
-    s<<JMP<<" "<<POSITION<<pos2<<endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,offset,RBP,s);
+  case IR_I2F: {
+    const char *x = d.kind == Location::REG ? d.reg : XMM0;
+    s << CVTSI2SDQ << loc(in.a) << COMMA << x << '\n';
+    emit_move(reg_loc(x), d, true, s);
+    break;
   }
-}
-
-void Equ_class::code(ostream &s) {
-  e1->code(s);
-  int addr1 = tempaddress;
-  e2->code(s);
-  int addr2 = tempaddress;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmov(RBP,addr1,RAX,s);
-    emit_mrmov(RBP,addr2,RDX,s);
-    emit_cmp(RDX,RAX,s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JE<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0", RAX, s);
-    s<<JMP<<" "<<POSITION<<pos2<< endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,offset,RBP,s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM1, s);
-    emit_mrmov(RBP, addr2, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JE<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0",RAX,s);
-    s<<JMP<<" "<<POSITION<<pos2<< endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,offset,RBP,s);
-  } else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmov(RBP,addr1,RAX,s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_mrmovsd(RBP, addr2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JE<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0",RAX,s);
-    s<<JMP<<" "<<POSITION<<pos2<<endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,0,RBP,s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM0, s);
-    emit_mrmovsd(RBP, addr2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JE<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0",RAX,s);
-    s<<JMP<<" "<<POSITION<<pos2<<endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,offset,RBP,s);
+  case IR_FCONST:
+    if (d.kind == Location::REG) {
+      emit_float_bits(in.fvalue, d.reg, s);
+    } else {
+      emit_float_bits(in.fvalue, XMM0, s);
+      emit_move(reg_loc(XMM0), d, true, s);
+    }
+    break;
+  case IR_STRING:
+    s<<MOV;
+    stringtable.lookup_string(in.name->get_string())->code_ref(s);
+    s<<COMMA<<d<<'\n';
+    break;
+  case IR_LEA:
+    emit_lea(loc(in.a), loc(in.b), in.scale, in.disp, d, s);
+    break;
+  case IR_SET:
+    emit_relation(in.rel, loc(in.a), loc(in.b), f.is_float(in.a) || f.is_float(in.b), d, s);
+    break;
+  case IR_CALL:
+    emit_call_insn(f, in, s);
+    break;
+  case IR_RET:
+    if (f.is_float(in.a)) {
+      emit_move(loc(in.a), reg_loc(XMM0), true, s);
+    } else if (in.a.kind != Operand::NONE) {
+      emit_move(loc(in.a), reg_loc(RAX), false, s);
+    }
+    emit_epilogue(s);
+    break;
+  case IR_JMP:
+    if (in.target[0] != next)
+      emit_branch(JMP, in.target[0]->label, s);
+    break;
+  case IR_BR:
+    emit_branch_insn(f, in, next, s);
+    break;
+  case IR_PHI:
+    // from_ssa() leaves none
+    break;
   }
 }
 
-void Neq_class::code(ostream &s) {
-  e1->code(s);
-  int addr1 = tempaddress;
-  e2->code(s);
-  int addr2 = tempaddress;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmov(RBP,addr1,RAX,s);
-    emit_mrmov(RBP,addr2,RDX,s);
-    emit_cmp(RDX,RAX,s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JNE<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0", RAX, s);
-    s<<JMP<<" "<<POSITION<<pos2<< endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,offset,RBP,s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM1, s);
-    emit_mrmov(RBP, addr2, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JNE<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0",RAX,s);
-    s<<JMP<<" "<<POSITION<<pos2<< endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,offset,RBP,s);
-  } else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmov(RBP, addr1, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_mrmovsd(RBP, addr2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JNE<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0",RAX,s);
-    s<<JMP<<" "<<POSITION<<pos2<<endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,0,RBP,s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM0, s);
-    emit_mrmovsd(RBP, addr2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JNE<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0",RAX,s);
-    s<<JMP<<" "<<POSITION<<pos2<<endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,offset,RBP,s);
-  }
-}
+//
+// Allocate registers for f, lay out its frame and emit it block by block.
+//
+static void emit_function(IrFunction &f, ostream &s)
+{
+  IntervalBuilder b(f);
 
-void Ge_class::code(ostream &s) {
-  e1->code(s);
-  int addr1 = tempaddress;
-  e2->code(s);
-  int addr2 = tempaddress;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmov(RBP,addr1,RAX,s);
-    emit_mrmov(RBP,addr2,RDX,s);
-    emit_cmp(RDX,RAX,s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JGE<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0", RAX, s);
-    s<<JMP<<" "<<POSITION<<pos2<< endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,offset,RBP,s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM1, s);
-    emit_mrmov(RBP, addr2, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JAE<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0",RAX,s);
-    s<<JMP<<" "<<POSITION<<pos2<< endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,offset,RBP,s);
-  } else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmov(RBP,addr1,RAX,s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_mrmovsd(RBP, addr2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JAE<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0",RAX,s);
-    s<<JMP<<" "<<POSITION<<pos2<<endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,0,RBP,s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM0, s);
-    emit_mrmovsd(RBP, addr2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JAE<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0",RAX,s);
-    s<<JMP<<" "<<POSITION<<pos2<<endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,offset,RBP,s);
+  // where the paras arrive, the ones passed on the stack sit above the
+  // return address
+  std::vector<Location> args;
+  int int_num = 0;
+  int float_num = 0;
+  int stack_offset = 16;
+  for (size_t i = 0; i < f.params.size(); i++) {
+    Location arg;
+    bool is_float = f.is_float(f.params[i]);
+    if (is_float && float_num < CALL_XMM_COUNT) {
+      arg = reg_loc(CALL_XMM[float_num ++]);
+    } else if (!is_float && int_num < CALL_REGS_COUNT) {
+      arg = reg_loc(CALL_REGS[int_num ++]);
+    } else {
+      arg.kind = Location::FRAME;
+      arg.offset = stack_offset;
+      stack_offset += 8;
+    }
+    args.push_back(arg);
   }
-}
+  allocate_registers(f, b, args);
 
-void Gt_class::code(ostream &s) {
-  e1->code(s);
-  int addr1 = tempaddress;
-  e2->code(s);
-  int addr2 = tempaddress;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmov(RBP,addr1,RAX,s);
-    emit_mrmov(RBP,addr2,RDX,s);
-    emit_cmp(RDX,RAX,s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JG<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0", RAX, s);
-    s<<JMP<<" "<<POSITION<<pos2<< endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,offset,RBP,s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM1, s);
-    emit_mrmov(RBP, addr2, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JA<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0",RAX,s);
-    s<<JMP<<" "<<POSITION<<pos2<< endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX,offset,RBP,s);
-  } else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmov(RBP, addr1, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_mrmovsd(RBP, addr2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JA<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0", RAX, s);
-    s<<JMP<<" "<<POSITION<<pos2<<endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX, 0, RBP, s);
-  } else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string()) {
-    emit_mrmovsd(RBP, addr1, XMM0, s);
-    emit_mrmovsd(RBP, addr2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = labelNum ++;
-    int pos2 = labelNum ++;
-    s<<JA<<" "<<POSITION<<pos1<<endl;
-    emit_mov("$0", RAX, s);
-    s<<JMP<<" "<<POSITION<<pos2<<endl;
-    s<<POSITION<<pos1<<":"<<endl;
-    emit_mov("$1",RAX,s);
-    s<<POSITION<<pos2<<":"<<endl;
-    emit_rmmov(RAX, offset, RBP, s);
+  // stack paras that did not get a register stay where they are
+  for (size_t i = 0; i < f.params.size(); i++) {
+    int vreg = f.params[i];
+    if (args[i].kind == Location::FRAME && locations[vreg].kind == Location::NONE) {
+      locations[vreg] = args[i];
+    }
+  }
+  int frame_size = layout_frame(f.name, b);
+  // a stack para moved into a register is still read through %rbp
+  for (size_t i = 0; i < f.params.size(); i++) {
+    if (args[i].kind == Location::FRAME && locations[f.params[i]].kind != Location::UNUSED) {
+      frameless = false;
+    }
   }
-}
-
-void And_class::code(ostream &s) {
-  e1->code(s);
-  int addr1 = tempaddress;
-  e2->code(s);
-  int addr2 = tempaddress;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
-
-  emit_mrmov(RBP, addr1, RAX, s);
-  emit_mrmov(RBP, addr2, RDX, s);
-  emit_and(RAX, RDX, s);
-  emit_rmmov(RDX, offset, RBP, s);
-}
-
-void Or_class::code(ostream &s) {
-  e1->code(s);
-  int addr1 = tempaddress;
-  e2->code(s);
-  int addr2 = tempaddress;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
-
-  emit_mrmov(RBP, addr1, RAX, s);
-  emit_mrmov(RBP, addr2, RDX, s);
-  emit_or(RAX, RDX, s);
-  emit_rmmov(RDX, offset, RBP, s);
-}
-
-void Xor_class::code(ostream &s) {
-  e1->code(s);
-  int addr1 = tempaddress;
-  e2->code(s);
-  int addr2 = tempaddress;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
-
-  emit_mrmov(RBP, addr1, RAX, s);
-  emit_mrmov(RBP, addr2, RDX, s);
-  emit_xor(RAX, RDX, s);
-  emit_rmmov(RDX, offset, RBP, s);
-}
-
-void Not_class::code(ostream &s) {
-  e1->code(s);
-  int addr1 = tempaddress;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
-
-  emit_mrmov(RBP, addr1, RAX, s);
-  emit_mov("$$0x0000000000000001", RDX, s);
-  emit_xor(RDX, RAX, s);
-  emit_rmmov(RAX, offset, RBX, s);
-}
-
-void Bitnot_class::code(ostream &s) {
-  e1->code(s);
-  int addr1 = tempaddress;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
-  
-  emit_mrmov(RBP, addr1, RAX, s);
-  emit_not(RAX, s);
-  emit_rmmov(RAX, offset, RBP, s);
-}
-
-void Bitand_class::code(ostream &s) {
-  e1->code(s);
-  int addr1 = tempaddress;
-  e2->code(s);
-  int addr2 = tempaddress;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
-
-  emit_mrmov(RBP, addr1, RAX, s);
-  emit_mrmov(RBP, addr2, RDX, s);
-  emit_and(RAX, RDX, s);
-  emit_rmmov(RDX, offset, RBP, s);
-}
-
-void Bitor_class::code(ostream &s) {
-  e1->code(s);
-  int addr1 = tempaddress;
-  e2->code(s);
-  int addr2 = tempaddress;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
-
-  emit_mrmov(RBP, addr1, RAX, s);
-  emit_mrmov(RBP, addr2, RDX, s);
-  emit_or(RAX, RDX, s);
-  emit_rmmov(RDX, offset, RBP, s);
-}
-
-void Const_int_class::code(ostream &s) {
-  emit_sub("$8",RSP,s);
-  offset -= 8;
-  tempaddress = offset;
-
-  s<<MOV<<"$"<<value<<COMMA<<RAX<<endl;
-  
-  emit_rmmov(RAX, tempaddress, RBP, s);
-}
-
-void Const_string_class::code(ostream &s) {
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
-  s<<MOV;
-  stringtable.lookup_string(value->get_string())->code_ref(s);
-  s<<COMMA<<RAX<<endl;
-
-  emit_rmmov(RAX, tempaddress, RBP, s);
-}
-
-void Const_float_class::code(ostream &s) {
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
 
-  double d_value = atof(value->get_string());
-  unsigned long long hex_value = *(unsigned long long *) &d_value;
-  char test[17];
-  sprintf(test, "%llx", hex_value);
-  
-  s<<MOV<<"$0x";
-  s<<test;
-  s<<COMMA<<RAX<<endl;
+  s<<GLOBAL<<f.name<<'\n'<<
+  SYMBOL_TYPE<<f.name<<COMMA<<FUNCTION<<'\n';
 
-  emit_rmmov(RAX, tempaddress, RBP, s);
-}
+  s<<f.name<<":"<<'\n';
+  if (!frameless) {
+    emit_push(RBP, s);
+    emit_mov(RSP, RBP, s);
+  }
+  for (size_t i = 0; i < saved_regs.size(); i++) {
+    emit_push(saved_regs[i], s);
+  }
+  if (frame_size > 0) {
+    s<<SUB<<"$"<<decimal(frame_size)<<COMMA<<RSP<<'\n';
+  }
 
-void Const_bool_class::code(ostream &s) {
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tempaddress = offset;
+  for (size_t i = 0; i < f.params.size(); i++) {
+    int vreg = f.params[i];
+    if (locations[vreg].kind != Location::UNUSED) {
+      emit_move(args[i], locations[vreg], f.is_float(vreg), s);
+    }
+  }
 
-  s<<MOV<<"$"<<value<<COMMA<<RAX<<endl;
+  // body
+  for (size_t n = 0; n < f.blocks.size(); n++) {
+    f.blocks[n]->label = labelNum ++;
+  }
+  for (size_t n = 0; n < f.blocks.size(); n++) {
+    IrBlock *block = f.blocks[n];
+    IrBlock *next = n + 1 < f.blocks.size() ? f.blocks[n + 1] : NULL;
+    // only jumps need a label, the block before never jumps to its next
+    bool jumped_to = false;
+    for (size_t p = 0; p < block->preds.size(); p++)
+      jumped_to = jumped_to || n == 0 || block->preds[p] != f.blocks[n - 1];
+    // a loop's top, which a later block branches back to, starts on 16
+    // bytes under -O unless that takes more than 10 bytes of padding
+    bool loop_top = false;
+    for (size_t p = 0; p < block->preds.size(); p++)
+      loop_top = loop_top || block->preds[p]->label >= block->label;
+    if (loop_top && cgen_optimize)
+      s<<P2ALIGN<<"4,,10"<<'\n';
+    if (jumped_to)
+      emit_label(block->label, s);
+    for (size_t i = 0; i < block->insns.size(); i++) {
+      emit_insn(f, block->insns[i], next, s);
+    }
+  }
 
-  emit_rmmov(RAX, tempaddress, RBP, s);
+  s<<SIZE<<f.name<<", "<<".-"<<f.name<<'\n';
 }
 
-void Object_class::code(ostream &s) {
-  variabletab.enterscope();
-  tempaddress = *variabletab.lookup(var);
-  variabletab.exitscope();
+void CallDecl_class::code(ostream &s) {
+  IrFunction f(name);
+  lower(f);
+  if (cgen_optimize) {
+    SsaStats stats;
+    optimize_ssa(f, pure_functions, cgen_unroll_factor, cgen_unroll_trips, stats);
+    if (cgen_debug)
+      cout << "SSA " << name << ": " << stats.before << " instructions, "
+           << stats.phis << " phis, " << stats.numbered << " value numbered, "
+           << stats.hoisted << " hoisted, " << stats.dead << " dead, "
+           << stats.after << " left, " << stats.unrolled << " loops unrolled, "
+           << stats.rotated << " loops rotated" << endl;
+  }
+  if (cgen_debug)
+    f.dump(cout);
+  emit_function(f, s);
 }
-
-void No_expr_class::code(ostream &s) {
-
-}
\ No newline at end of file
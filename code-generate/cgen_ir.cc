@@ -0,0 +1,834 @@
+//**************************************************************
+//
+// Three-address code and lowering function bodies into it.
+//
+//**************************************************************
+
+#include <algorithm>
+#include "cgen.h"
+#include "cgen_ir.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////////
+//
+//    IrInsn and IrFunction
+//
+//////////////////////////////////////////////////////////////////
+
+void IrInsn::operands(vector<Operand *> &out)
+{
+  out.clear();
+  if (a.kind != Operand::NONE)
+    out.push_back(&a);
+  if (b.kind != Operand::NONE)
+    out.push_back(&b);
+  for (size_t i = 0; i < args.size(); i++)
+    out.push_back(&args[i]);
+}
+
+IrFunction::~IrFunction()
+{
+  for (size_t i = 0; i < created.size(); i++)
+    delete created[i];
+}
+
+int IrFunction::new_temp(TypeKind kind)
+{
+  kinds.push_back(kind);
+  variables.push_back(false);
+  globals.push_back(NULL);
+  return kinds.size() - 1;
+}
+
+int IrFunction::new_variable(TypeKind kind)
+{
+  int vreg = new_temp(kind);
+  variables[vreg] = true;
+  return vreg;
+}
+
+int IrFunction::new_global(Symbol global, TypeKind kind)
+{
+  int vreg = new_variable(kind);
+  globals[vreg] = global;
+  return vreg;
+}
+
+IrBlock *IrFunction::new_block()
+{
+  IrBlock *b = new IrBlock(created.size());
+  created.push_back(b);
+  return b;
+}
+
+// the blocks control may go to when it leaves b, fall through first
+static void successors(IrFunction &f, size_t n, vector<IrBlock *> &out)
+{
+  IrBlock *b = f.blocks[n];
+  out.clear();
+  if (!b->terminated()) {
+    if (n + 1 < f.blocks.size())
+      out.push_back(f.blocks[n + 1]);
+    return;
+  }
+  IrInsn &last = b->insns.back();
+  if (last.op == IR_JMP) {
+    out.push_back(last.target[0]);
+  } else if (last.op == IR_BR) {
+    out.push_back(last.target[0]);
+    if (last.target[1] != last.target[0])
+      out.push_back(last.target[1]);
+  }
+}
+
+void IrFunction::link()
+{
+  // a block is reachable if some reachable block goes to it; blocks
+  // only ever jump to blocks that are placed
+  vector<bool> reached(created.size(), false);
+  vector<IrBlock *> work;
+  vector<IrBlock *> succ;
+  std::map<IrBlock *, size_t> position;
+  for (size_t n = 0; n < blocks.size(); n++)
+    position[blocks[n]] = n;
+
+  reached[blocks[0]->id] = true;
+  work.push_back(blocks[0]);
+  while (!work.empty()) {
+    IrBlock *b = work.back();
+    work.pop_back();
+    successors(*this, position[b], succ);
+    for (size_t i = 0; i < succ.size(); i++) {
+      if (!reached[succ[i]->id]) {
+        reached[succ[i]->id] = true;
+        work.push_back(succ[i]);
+      }
+    }
+  }
+
+  // dropping a block that falls through is fine, nothing reaches it
+  vector<IrBlock *> kept;
+  for (size_t n = 0; n < blocks.size(); n++)
+    if (reached[blocks[n]->id])
+      kept.push_back(blocks[n]);
+  blocks = kept;
+
+  for (size_t n = 0; n < blocks.size(); n++) {
+    blocks[n]->succs.clear();
+    blocks[n]->preds.clear();
+  }
+  for (size_t n = 0; n < blocks.size(); n++) {
+    successors(*this, n, blocks[n]->succs);
+    for (size_t i = 0; i < blocks[n]->succs.size(); i++)
+      blocks[n]->succs[i]->preds.push_back(blocks[n]);
+  }
+}
+
+static const char *OP_NAMES[] = {
+  "mov", "add", "sub", "mul", "div", "mod", "and", "or", "xor", "neg", "not",
+  "fadd", "fsub", "fmul", "fdiv", "fneg", "i2f", "fconst", "string", "lea",
+  "set", "call", "ret", "jmp", "br", "phi"
+};
+static const char *REL_NAMES[] = {"lt", "le", "eq", "ne", "ge", "gt"};
+
+static void dump_operand(ostream &s, IrFunction &f, const Operand &o)
+{
+  if (o.kind == Operand::IMM)
+    s << "$" << o.value;
+  else if (o.kind == Operand::VREG && f.global(o.vreg) != NULL)
+    s << f.global(o.vreg);
+  else if (o.kind == Operand::VREG)
+    s << (f.is_variable(o.vreg) ? "v" : "t") << o.vreg;
+  else
+    s << "_";
+}
+
+void IrFunction::dump(ostream &s)
+{
+  s << "function " << name << "(";
+  for (size_t i = 0; i < params.size(); i++)
+    s << (i > 0 ? ", " : "") << "v" << params[i];
+  s << ")" << endl;
+  for (size_t n = 0; n < blocks.size(); n++) {
+    IrBlock *b = blocks[n];
+    s << "B" << b->id << ":";
+    if (!b->preds.empty()) {
+      s << "\t\t; preds";
+      for (size_t i = 0; i < b->preds.size(); i++)
+        s << " B" << b->preds[i]->id;
+    }
+    s << endl;
+    for (size_t i = 0; i < b->insns.size(); i++) {
+      IrInsn &in = b->insns[i];
+      s << "\t";
+      if (in.dst >= 0) {
+        dump_operand(s, *this, vreg_op(in.dst));
+        s << " = ";
+      }
+      s << OP_NAMES[in.op];
+      if (in.op == IR_SET || in.op == IR_BR)
+        s << " " << REL_NAMES[in.rel];
+      if (in.op == IR_CALL || in.op == IR_STRING)
+        s << " " << in.name;
+      if (in.op == IR_FCONST)
+        s << " " << in.fvalue;
+      vector<Operand *> ops;
+      in.operands(ops);
+      for (size_t o = 0; o < ops.size(); o++) {
+        s << (o == 0 ? " " : ", ");
+        dump_operand(s, *this, *ops[o]);
+      }
+      if (in.op == IR_LEA)
+        s << " * " << in.scale << " + " << in.disp;
+      if (in.op == IR_JMP || in.op == IR_BR)
+        s << " -> B" << in.target[0]->id;
+      if (in.op == IR_BR)
+        s << ", B" << in.target[1]->id;
+      s << endl;
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//    IrBuilder
+//
+//////////////////////////////////////////////////////////////////
+
+IrBuilder::IrBuilder(IrFunction &fn)
+  : f(fn), current(NULL), continue_target(NULL), break_target(NULL)
+{
+  place(f.new_block());
+}
+
+vector<int> &IrBuilder::vregs_of(Binding::Kind kind)
+{
+  switch (kind) {
+  case Binding::PARA:
+    return params;
+  case Binding::LOCAL:
+    return locals;
+  default:
+    return globals;
+  }
+}
+
+IrInsn &IrBuilder::emit(IrOp op, int dst)
+{
+  if (current->terminated())
+    place(f.new_block());
+  current->insns.push_back(IrInsn(op, dst));
+  return current->insns.back();
+}
+
+void IrBuilder::place(IrBlock *b)
+{
+  f.blocks.push_back(b);
+  current = b;
+}
+
+void IrBuilder::jump(IrBlock *to)
+{
+  emit(IR_JMP, -1).target[0] = to;
+}
+
+void IrBuilder::branch(Relation rel, Operand a, Operand b, IrBlock *if_true, IrBlock *if_false)
+{
+  IrInsn &in = emit(IR_BR, -1);
+  in.rel = rel;
+  in.a = a;
+  in.b = b;
+  in.target[0] = if_true;
+  in.target[1] = if_false;
+}
+
+int IrBuilder::declare(const Binding &b, TypeKind kind)
+{
+  int vreg = f.new_variable(kind);
+  vector<int> &slots = vregs_of(b.kind);
+  if ((int) slots.size() <= b.index)
+    slots.resize(b.index + 1, -1);
+  slots[b.index] = vreg;
+  return vreg;
+}
+
+int IrBuilder::lookup(const Binding &b, TypeKind kind)
+{
+  vector<int> &slots = vregs_of(b.kind);
+  if ((int) slots.size() <= b.index)
+    slots.resize(b.index + 1, -1);
+  if (slots[b.index] < 0 && b.kind == Binding::STATIC)
+    slots[b.index] = f.new_global(b.name, kind);
+  return slots[b.index];
+}
+
+Operand IrBuilder::to_float(Operand o)
+{
+  if (f.is_float(o))
+    return o;
+  int t = f.new_temp(TYPE_FLOAT);
+  if (o.kind == Operand::IMM) {
+    emit(IR_FCONST, t).fvalue = (double) o.value;
+  } else {
+    emit(IR_I2F, t).a = o;
+  }
+  return vreg_op(t);
+}
+
+Operand IrBuilder::to_reg(Operand o)
+{
+  if (o.kind != Operand::IMM)
+    return o;
+  int t = f.new_temp(TYPE_INT);
+  emit(IR_MOV, t).a = o;
+  return vreg_op(t);
+}
+
+bool IrBuilder::retarget(Operand v, int var)
+{
+  if (v.kind != Operand::VREG || f.is_variable(v.vreg) || current->insns.empty() ||
+      current->insns.back().dst != v.vreg || f.is_float(v.vreg) != f.is_float(var))
+    return false;
+  current->insns.back().dst = var;
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//    Addresses
+//
+//  Int sums of a base, an index scaled by 1, 2, 4 or 8 and a 32-bit
+//  displacement are computed by one leaq.  address() describes a sum in
+//  that shape, merging the operands' own shapes where they fit, and
+//  scaled() a product leaq can scale by.
+//
+//////////////////////////////////////////////////////////////////
+
+static bool int_imm(Expr e, long long &v)
+{
+  return e->getKind() == TYPE_INT && e->int_value(v) && fits_imm(v);
+}
+
+// other + disp, taking over other's own address if it has one
+static void add_disp(Expr other, long long disp, Address &a)
+{
+  Address inner;
+  Expr index;
+  int scale;
+  if (other->address(inner) && fits_imm(inner.disp + disp)) {
+    a = inner;
+    a.disp += disp;
+    a.fused = true;
+  } else if (other->scaled(index, scale)) {
+    a.index = index;
+    a.scale = scale;
+    a.disp = disp;
+    a.fused = true;
+  } else {
+    a.base = other;
+    a.disp = disp;
+  }
+}
+
+bool Add_class::address(Address &a) {
+  if (kind != TYPE_INT)
+    return false;
+
+  long long c;
+  Address inner;
+  Expr index;
+  int scale;
+  if (int_imm(e2, c)) {
+    add_disp(e1, c, a);
+  } else if (int_imm(e1, c)) {
+    add_disp(e2, c, a);
+  } else if (e2->scaled(index, scale)) {
+    if (e1->address(inner) && inner.index == NULL)
+      a = inner;
+    else
+      a.base = e1;
+    a.index = index;
+    a.scale = scale;
+    a.fused = true;
+  } else if (e1->scaled(index, scale)) {
+    a.base = e2;
+    a.index = index;
+    a.scale = scale;
+    a.fused = true;
+    a.index_first = true;
+  } else if (e1->address(inner) && inner.index == NULL) {
+    a = inner;
+    a.index = e2;
+    a.fused = true;
+  } else {
+    a.base = e1;
+    a.index = e2;
+  }
+  return true;
+}
+
+bool Minus_class::address(Address &a) {
+  long long c;
+  if (kind != TYPE_INT || !int_imm(e2, c) || !fits_imm(-c))
+    return false;
+  add_disp(e1, -c, a);
+  return true;
+}
+
+bool Multi_class::scaled(Expr &index, int &scale) {
+  long long c;
+  if (kind != TYPE_INT)
+    return false;
+  if (int_imm(e2, c) && (c == 1 || c == 2 || c == 4 || c == 8)) {
+    index = e1;
+  } else if (int_imm(e1, c) && (c == 1 || c == 2 || c == 4 || c == 8)) {
+    index = e2;
+  } else {
+    return false;
+  }
+  scale = c;
+  return true;
+}
+
+//
+// Lower the operands of a fused address in source order and compute it
+// with one IR_LEA.  Immediates among them fold into the displacement as
+// long as it stays within 32 bits.
+//
+static Operand lower_address(IrBuilder &b, const Address &a)
+{
+  Expr first = a.index_first || a.base == NULL ? a.index : a.base;
+  Expr second = first == a.base ? a.index : a.base;
+  first->lower(b);
+  if (second != NULL)
+    second->lower(b);
+
+  Operand base = a.base != NULL ? a.base->operand : Operand();
+  Operand index = a.index != NULL ? a.index->operand : Operand();
+  long long disp = a.disp;
+  if (base.kind == Operand::IMM && fits_imm(disp + base.value)) {
+    disp += base.value;
+    base = Operand();
+  }
+  if (index.kind == Operand::IMM && fits_imm(disp + index.value * a.scale)) {
+    disp += index.value * a.scale;
+    index = Operand();
+  }
+  if (base.kind == Operand::NONE && index.kind == Operand::NONE)
+    return imm_op(disp);
+
+  base = b.to_reg(base);
+  index = b.to_reg(index);
+  int dst = b.function().new_temp(TYPE_INT);
+  IrInsn &in = b.emit(IR_LEA, dst);
+  in.a = base;
+  in.b = index;
+  in.scale = a.scale;
+  in.disp = disp;
+  return vreg_op(dst);
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//    Lowering function bodies
+//
+//  Every expression leaves its value in operand, conditions branch to
+//  one of two blocks instead.  Blocks are placed where the old
+//  code generator put its labels, so the layout follows the source.
+//
+//////////////////////////////////////////////////////////////////
+
+// dst = e1 op e2 for Int operations, op2 for Float ones
+static Operand lower_binary(IrBuilder &b, IrOp op, IrOp fop, TypeKind kind, Expr e1, Expr e2)
+{
+  IrFunction &f = b.function();
+  e1->lower(b);
+  e2->lower(b);
+  Operand x = e1->operand;
+  Operand y = e2->operand;
+  if (kind == TYPE_FLOAT) {
+    x = b.to_float(x);
+    y = b.to_float(y);
+  } else if (op == IR_DIV || op == IR_MOD) {
+    y = b.to_reg(y);
+  }
+  int dst = f.new_temp(kind);
+  IrInsn &in = b.emit(kind == TYPE_FLOAT ? fop : op, dst);
+  in.a = x;
+  in.b = y;
+  return vreg_op(dst);
+}
+
+// the operands of a comparison, both Float if either is
+static void lower_compare(IrBuilder &b, Expr e1, Expr e2, Operand &x, Operand &y)
+{
+  e1->lower(b);
+  e2->lower(b);
+  x = e1->operand;
+  y = e2->operand;
+  if (e1->getKind() == TYPE_FLOAT || e2->getKind() == TYPE_FLOAT) {
+    x = b.to_float(x);
+    y = b.to_float(y);
+  }
+}
+
+static Operand lower_relation(IrBuilder &b, Relation rel, Expr e1, Expr e2)
+{
+  Operand x, y;
+  lower_compare(b, e1, e2, x, y);
+  int dst = b.function().new_temp(TYPE_BOOL);
+  IrInsn &in = b.emit(IR_SET, dst);
+  in.rel = rel;
+  in.a = x;
+  in.b = y;
+  return vreg_op(dst);
+}
+
+static void lower_compare_branch(IrBuilder &b, Relation rel, Expr e1, Expr e2,
+                                 IrBlock *if_true, IrBlock *if_false)
+{
+  Operand x, y;
+  lower_compare(b, e1, e2, x, y);
+  b.branch(rel, x, y, if_true, if_false);
+}
+
+//
+// And and Or stop as soon as the left operand decides the result, so the
+// right one is not evaluated at all then.  As values they are lowered as
+// conditions that pick 0 or 1.
+//
+static Operand lower_condition_value(IrBuilder &b, Expr e)
+{
+  IrFunction &f = b.function();
+  IrBlock *true_block = f.new_block();
+  IrBlock *false_block = f.new_block();
+  IrBlock *end = f.new_block();
+  int dst = f.new_temp(TYPE_BOOL);
+
+  e->lower_branch(b, true_block, false_block);
+  b.place(true_block);
+  b.emit(IR_MOV, dst).a = imm_op(1);
+  b.jump(end);
+  b.place(false_block);
+  b.emit(IR_MOV, dst).a = imm_op(0);
+  b.place(end);
+  return vreg_op(dst);
+}
+
+static Operand lower_unary(IrBuilder &b, IrOp op, TypeKind kind, Operand a)
+{
+  int dst = b.function().new_temp(kind);
+  b.emit(op, dst).a = a;
+  return vreg_op(dst);
+}
+
+void CallDecl_class::lower(IrFunction &f) {
+  IrBuilder b(f);
+  for (int i=paras->first(); paras->more(i); i=paras->next(i)) {
+    Variable para = paras->nth(i);
+    f.params.push_back(b.declare(para->binding, type_kind(para->getType())));
+  }
+  body->lower(b);
+  f.link();
+}
+
+void StmtBlock_class::lower(IrBuilder &b) {
+  for (int i=vars->first(); vars->more(i); i=vars->next(i)) {
+    Variable var = vars->nth(i)->getVariable();
+    b.declare(var->binding, type_kind(var->getType()));
+  }
+  for (int i=stmts->first(); stmts->more(i); i=stmts->next(i)) {
+    stmts->nth(i)->lower(b);
+  }
+}
+
+void IfStmt_class::lower(IrBuilder &b) {
+  IrFunction &f = b.function();
+  IrBlock *then_block = f.new_block();
+  IrBlock *else_block = f.new_block();
+  IrBlock *end = f.new_block();
+
+  condition->lower_branch(b, then_block, else_block);
+  b.place(then_block);
+  thenexpr->lower(b);
+  b.jump(end);
+  b.place(else_block);
+  elseexpr->lower(b);
+  b.place(end);
+}
+
+void WhileStmt_class::lower(IrBuilder &b) {
+  IrFunction &f = b.function();
+  IrBlock *head = f.new_block();
+  IrBlock *loop_body = f.new_block();
+  IrBlock *end = f.new_block();
+  IrBlock *outer_continue = b.continue_target;
+  IrBlock *outer_break = b.break_target;
+  b.continue_target = head;
+  b.break_target = end;
+
+  b.place(head);
+  condition->lower_branch(b, loop_body, end);
+  b.place(loop_body);
+  body->lower(b);
+  b.jump(head);
+  b.place(end);
+
+  b.continue_target = outer_continue;
+  b.break_target = outer_break;
+}
+
+void ForStmt_class::lower(IrBuilder &b) {
+  IrFunction &f = b.function();
+  IrBlock *head = f.new_block();
+  IrBlock *loop_body = f.new_block();
+  IrBlock *step = f.new_block();
+  IrBlock *end = f.new_block();
+  IrBlock *outer_continue = b.continue_target;
+  IrBlock *outer_break = b.break_target;
+  b.continue_target = step;
+  b.break_target = end;
+
+  initexpr->lower(b);
+  b.place(head);
+  if (!condition->is_empty_Expr()) {
+    condition->lower_branch(b, loop_body, end);
+  }
+  b.place(loop_body);
+  body->lower(b);
+  b.place(step);
+  loopact->lower(b);
+  b.jump(head);
+  b.place(end);
+
+  b.continue_target = outer_continue;
+  b.break_target = outer_break;
+}
+
+void ReturnStmt_class::lower(IrBuilder &b) {
+  value->lower(b);
+  b.emit(IR_RET, -1).a = value->operand;
+}
+
+void ContinueStmt_class::lower(IrBuilder &b) {
+  b.jump(b.continue_target);
+}
+
+void BreakStmt_class::lower(IrBuilder &b) {
+  b.jump(b.break_target);
+}
+
+// any other value is tested against 0
+void Expr_class::lower_branch(IrBuilder &b, IrBlock *if_true, IrBlock *if_false) {
+  lower(b);
+  b.branch(REL_NE, operand, imm_op(0), if_true, if_false);
+}
+
+void Call_class::lower(IrBuilder &b) {
+  IrFunction &f = b.function();
+  for (int i=actuals->first(); actuals->more(i); i=actuals->next(i)) {
+    actuals->nth(i)->lower(b);
+  }
+  int dst = kind == TYPE_VOID ? -1 : f.new_temp(kind);
+  IrInsn &in = b.emit(IR_CALL, dst);
+  in.name = name;
+  for (int i=actuals->first(); actuals->more(i); i=actuals->next(i)) {
+    in.args.push_back(actuals->nth(i)->operand);
+  }
+  operand = dst < 0 ? Operand() : vreg_op(dst);
+}
+
+void Actual_class::lower(IrBuilder &b) {
+  expr->lower(b);
+  operand = expr->operand;
+}
+
+// a temporary computed only to be stored is computed into the variable
+void Assign_class::lower(IrBuilder &b) {
+  value->lower(b);
+  int var = b.lookup(binding, kind);
+  if (!b.retarget(value->operand, var)) {
+    b.emit(IR_MOV, var).a = value->operand;
+  }
+  operand = vreg_op(var);
+}
+
+void Add_class::lower(IrBuilder &b) {
+  Address a;
+  if (address(a) && a.fused) {
+    operand = lower_address(b, a);
+  } else {
+    operand = lower_binary(b, IR_ADD, IR_FADD, kind, e1, e2);
+  }
+}
+
+void Minus_class::lower(IrBuilder &b) {
+  Address a;
+  if (address(a) && a.fused) {
+    operand = lower_address(b, a);
+  } else {
+    operand = lower_binary(b, IR_SUB, IR_FSUB, kind, e1, e2);
+  }
+}
+
+void Multi_class::lower(IrBuilder &b) {
+  operand = lower_binary(b, IR_MUL, IR_FMUL, kind, e1, e2);
+}
+
+void Divide_class::lower(IrBuilder &b) {
+  operand = lower_binary(b, IR_DIV, IR_FDIV, kind, e1, e2);
+}
+
+void Mod_class::lower(IrBuilder &b) {
+  operand = lower_binary(b, IR_MOD, IR_MOD, TYPE_INT, e1, e2);
+}
+
+void Neg_class::lower(IrBuilder &b) {
+  e1->lower(b);
+  if (kind == TYPE_FLOAT) {
+    operand = lower_unary(b, IR_FNEG, TYPE_FLOAT, e1->operand);
+  } else {
+    operand = lower_unary(b, IR_NEG, TYPE_INT, e1->operand);
+  }
+}
+
+void Lt_class::lower(IrBuilder &b) {
+  operand = lower_relation(b, REL_LT, e1, e2);
+}
+
+void Lt_class::lower_branch(IrBuilder &b, IrBlock *if_true, IrBlock *if_false) {
+  lower_compare_branch(b, REL_LT, e1, e2, if_true, if_false);
+}
+
+void Le_class::lower(IrBuilder &b) {
+  operand = lower_relation(b, REL_LE, e1, e2);
+}
+
+void Le_class::lower_branch(IrBuilder &b, IrBlock *if_true, IrBlock *if_false) {
+  lower_compare_branch(b, REL_LE, e1, e2, if_true, if_false);
+}
+
+void Equ_class::lower(IrBuilder &b) {
+  operand = lower_relation(b, REL_EQ, e1, e2);
+}
+
+void Equ_class::lower_branch(IrBuilder &b, IrBlock *if_true, IrBlock *if_false) {
+  lower_compare_branch(b, REL_EQ, e1, e2, if_true, if_false);
+}
+
+void Neq_class::lower(IrBuilder &b) {
+  operand = lower_relation(b, REL_NE, e1, e2);
+}
+
+void Neq_class::lower_branch(IrBuilder &b, IrBlock *if_true, IrBlock *if_false) {
+  lower_compare_branch(b, REL_NE, e1, e2, if_true, if_false);
+}
+
+void Ge_class::lower(IrBuilder &b) {
+  operand = lower_relation(b, REL_GE, e1, e2);
+}
+
+void Ge_class::lower_branch(IrBuilder &b, IrBlock *if_true, IrBlock *if_false) {
+  lower_compare_branch(b, REL_GE, e1, e2, if_true, if_false);
+}
+
+void Gt_class::lower(IrBuilder &b) {
+  operand = lower_relation(b, REL_GT, e1, e2);
+}
+
+void Gt_class::lower_branch(IrBuilder &b, IrBlock *if_true, IrBlock *if_false) {
+  lower_compare_branch(b, REL_GT, e1, e2, if_true, if_false);
+}
+
+void And_class::lower(IrBuilder &b) {
+  operand = lower_condition_value(b, this);
+}
+
+void And_class::lower_branch(IrBuilder &b, IrBlock *if_true, IrBlock *if_false) {
+  IrBlock *right = b.function().new_block();
+  e1->lower_branch(b, right, if_false);
+  b.place(right);
+  e2->lower_branch(b, if_true, if_false);
+}
+
+void Or_class::lower(IrBuilder &b) {
+  operand = lower_condition_value(b, this);
+}
+
+void Or_class::lower_branch(IrBuilder &b, IrBlock *if_true, IrBlock *if_false) {
+  IrBlock *right = b.function().new_block();
+  e1->lower_branch(b, if_true, right);
+  b.place(right);
+  e2->lower_branch(b, if_true, if_false);
+}
+
+void Xor_class::lower(IrBuilder &b) {
+  operand = lower_binary(b, IR_XOR, IR_XOR, TYPE_BOOL, e1, e2);
+}
+
+void Not_class::lower(IrBuilder &b) {
+  e1->lower(b);
+  int dst = b.function().new_temp(TYPE_BOOL);
+  IrInsn &in = b.emit(IR_XOR, dst);
+  in.a = e1->operand;
+  in.b = imm_op(1);
+  operand = vreg_op(dst);
+}
+
+void Not_class::lower_branch(IrBuilder &b, IrBlock *if_true, IrBlock *if_false) {
+  e1->lower_branch(b, if_false, if_true);
+}
+
+void Bitnot_class::lower(IrBuilder &b) {
+  e1->lower(b);
+  operand = lower_unary(b, IR_NOT, TYPE_INT, e1->operand);
+}
+
+void Bitand_class::lower(IrBuilder &b) {
+  operand = lower_binary(b, IR_AND, IR_AND, TYPE_INT, e1, e2);
+}
+
+void Bitor_class::lower(IrBuilder &b) {
+  operand = lower_binary(b, IR_OR, IR_OR, TYPE_INT, e1, e2);
+}
+
+// only a register takes a full 64-bit immediate
+void Const_int_class::lower(IrBuilder &b) {
+  long long v = ((IntEntryP) value)->get_value();
+  operand = imm_op(v);
+  if (!fits_imm(v)) {
+    int dst = b.function().new_temp(TYPE_INT);
+    b.emit(IR_MOV, dst).a = operand;
+    operand = vreg_op(dst);
+  }
+}
+
+void Const_string_class::lower(IrBuilder &b) {
+  int dst = b.function().new_temp(TYPE_STRING);
+  b.emit(IR_STRING, dst).name = value;
+  operand = vreg_op(dst);
+}
+
+void Const_float_class::lower(IrBuilder &b) {
+  int dst = b.function().new_temp(TYPE_FLOAT);
+  b.emit(IR_FCONST, dst).fvalue = ((FloatEntryP) value)->get_value();
+  operand = vreg_op(dst);
+}
+
+void Const_bool_class::lower(IrBuilder &b) {
+  operand = imm_op(value);
+}
+
+// a folded condition is known here, either always true or never
+void Const_bool_class::lower_branch(IrBuilder &b, IrBlock *if_true, IrBlock *if_false) {
+  b.jump(value ? if_true : if_false);
+}
+
+void Object_class::lower(IrBuilder &b) {
+  operand = vreg_op(b.lookup(binding, kind));
+}
+
+void No_expr_class::lower(IrBuilder &b) {
+  operand = Operand();
+}
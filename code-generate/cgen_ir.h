@@ -0,0 +1,203 @@
+#ifndef CGEN_IR_H
+#define CGEN_IR_H
+
+//
+// Three-address code for the code generator.
+//
+// CallDecl_class::code lowers a function body into an IrFunction: basic
+// blocks of IrInsns over virtual registers, each instruction one Int,
+// Float or Bool operation on at most two operands.  An operand is a
+// virtual register or an immediate; immediates fit 32 bits except as the
+// source of an IR_MOV.  Locals and paras are virtual registers that may
+// be assigned many times, globals are virtual registers fixed to their
+// memory.  Int operands of Float operations are converted by an explicit
+// IR_I2F.
+//
+// A block ends in IR_JMP, IR_BR or IR_RET, or falls through to the next
+// block in layout order.  Under -O the function passes through SSA form
+// (cgen_ssa.cc) on the way; the register allocator (cgen_regalloc.cc) and
+// the x86-64 emitter (cgen.cc) only ever see it without IR_PHIs.
+//
+
+#include <vector>
+#include <iostream>
+#include <stdint.h>
+#include "stringtab.h"
+#include "seal-tree.handcode.h"
+
+enum Relation { REL_LT, REL_LE, REL_EQ, REL_NE, REL_GE, REL_GT };
+
+enum IrOp {
+  IR_MOV,       // dst = a
+  IR_ADD,       // Int dst = a op b
+  IR_SUB,
+  IR_MUL,
+  IR_DIV,       // b is never an immediate, idivq takes none
+  IR_MOD,
+  IR_AND,
+  IR_OR,
+  IR_XOR,
+  IR_NEG,       // Int dst = op a
+  IR_NOT,
+  IR_FADD,      // Float dst = a op b
+  IR_FSUB,
+  IR_FMUL,
+  IR_FDIV,
+  IR_FNEG,      // Float dst = -a
+  IR_I2F,       // Float dst = Int a
+  IR_FCONST,    // Float dst = fvalue
+  IR_STRING,    // dst = address of the string constant name
+  IR_LEA,       // Int dst = a + b * scale + disp, a or b may be missing
+  IR_SET,       // dst = a rel b as 0 or 1
+  IR_CALL,      // dst = name(args), no dst for Void
+  IR_RET,       // return a, nothing for Void
+  IR_JMP,       // goto target[0]
+  IR_BR,        // if a rel b goto target[0] else goto target[1]
+  IR_PHI        // dst = args[i] coming from preds[i], only in SSA form
+};
+
+struct IrBlock;
+
+inline bool fits_imm(long long v)
+{
+  return v >= INT32_MIN && v <= INT32_MAX;
+}
+
+inline Operand vreg_op(int vreg)
+{
+  Operand o;
+  o.kind = Operand::VREG;
+  o.vreg = vreg;
+  return o;
+}
+
+inline Operand imm_op(long long value)
+{
+  Operand o;
+  o.kind = Operand::IMM;
+  o.value = value;
+  return o;
+}
+
+struct IrInsn {
+  IrOp op;
+  int dst;                      // virtual register written, -1 if none
+  Operand a, b;
+  Relation rel;                 // IR_SET, IR_BR
+  int scale;                    // IR_LEA
+  long long disp;               // IR_LEA
+  double fvalue;                // IR_FCONST
+  Symbol name;                  // IR_CALL callee, IR_STRING constant
+  std::vector<Operand> args;    // IR_CALL, IR_PHI
+  IrBlock *target[2];           // IR_JMP, IR_BR
+
+  IrInsn(IrOp o, int d)
+    : op(o), dst(d), rel(REL_EQ), scale(1), disp(0), fvalue(0), name(NULL) {
+    target[0] = target[1] = NULL;
+  }
+  bool is_terminator() { return op == IR_JMP || op == IR_BR || op == IR_RET; }
+  // the operands read, in order
+  void operands(std::vector<Operand *> &out);
+};
+
+struct IrBlock {
+  int id;                       // creation order, names the block in dumps
+  int label;                    // assembly label, given by the emitter
+  std::vector<IrInsn> insns;
+  std::vector<IrBlock *> succs;
+  std::vector<IrBlock *> preds;
+
+  IrBlock(int i) : id(i), label(-1) {}
+  bool terminated() { return !insns.empty() && insns.back().is_terminator(); }
+};
+
+class IrFunction {
+private:
+  std::vector<TypeKind> kinds;          // indexed by vreg
+  std::vector<bool> variables;
+  std::vector<Symbol> globals;
+  std::vector<IrBlock *> created;       // every block, for the destructor
+
+public:
+  Symbol name;
+  std::vector<int> params;              // vreg of each para, in order
+  std::vector<IrBlock *> blocks;        // layout order, entry first
+
+  IrFunction(Symbol n) : name(n) {}
+  ~IrFunction();
+
+  // a temporary, a local or para, or the global name
+  int new_temp(TypeKind kind);
+  int new_variable(TypeKind kind);
+  int new_global(Symbol global, TypeKind kind);
+  IrBlock *new_block();
+
+  int vregs() { return kinds.size(); }
+  TypeKind kind(int vreg) { return kinds[vreg]; }
+  bool is_float(int vreg) { return kinds[vreg] == TYPE_FLOAT; }
+  bool is_float(const Operand &o) { return o.kind == Operand::VREG && is_float(o.vreg); }
+  bool is_variable(int vreg) { return variables[vreg]; }
+  Symbol global(int vreg) { return globals[vreg]; }
+
+  // drop the blocks no path from the entry reaches and fill in preds and
+  // succs of the rest
+  void link();
+  void dump(std::ostream &s);
+};
+
+//
+// Lowers one function body.  Instructions go to the end of the current
+// block; place() makes a block current and puts it next in the layout.
+// Code after a jump or return lands in a fresh block that link() drops.
+//
+class IrBuilder {
+private:
+  IrFunction &f;
+  IrBlock *current;
+  std::vector<int> params;              // vreg of each para, by position
+  std::vector<int> locals;              // vreg of each local, by slot
+  std::vector<int> globals;             // vreg of each global, -1 until referenced
+
+  std::vector<int> &vregs_of(Binding::Kind kind);
+
+public:
+  IrBlock *continue_target;
+  IrBlock *break_target;
+
+  IrBuilder(IrFunction &fn);
+
+  IrFunction &function() { return f; }
+  IrInsn &emit(IrOp op, int dst);
+  void place(IrBlock *b);
+  void jump(IrBlock *to);
+  void branch(Relation rel, Operand a, Operand b, IrBlock *if_true, IrBlock *if_false);
+
+  // a local or para coming into scope
+  int declare(const Binding &b, TypeKind kind);
+  // the virtual register of a resolved name, globals get a fixed one
+  int lookup(const Binding &b, TypeKind kind);
+
+  // o as a Float, converting an Int
+  Operand to_float(Operand o);
+  // o in a virtual register, for operations that take no immediate
+  Operand to_reg(Operand o);
+  // have the instruction that just computed the temporary v write var
+  // instead; false if v was not computed that way
+  bool retarget(Operand v, int var);
+};
+
+//
+// base + index*scale + disp, the sum one leaq computes.  A fused address
+// swallows a Multi or an inner Add or Minus: the swallowed node is never
+// lowered, its operands are evaluated directly.  index_first keeps the
+// source order when the index comes first.
+//
+struct Address {
+  Expr base, index;
+  int scale;
+  long long disp;
+  bool fused, index_first;
+  Address() : base(NULL), index(NULL), scale(1), disp(0), fused(false), index_first(false) {}
+};
+
+#endif
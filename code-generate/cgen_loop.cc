@@ -0,0 +1,686 @@
+//**************************************************************
+//
+// Natural loops, preheaders, loop-invariant code motion and unrolling.
+//
+//**************************************************************
+
+#include <algorithm>
+#include <map>
+#include "cgen_loop.h"
+#include "cgen_ssa.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////////
+//
+//    Natural loops
+//
+//////////////////////////////////////////////////////////////////
+
+static bool inner_first(const Loop &a, const Loop &b)
+{
+  return a.blocks.size() < b.blocks.size();
+}
+
+void find_loops(IrFunction &f, DominatorTree &dom, vector<Loop> &loops)
+{
+  int size = 0;
+  for (size_t n = 0; n < f.blocks.size(); n++)
+    size = max(size, f.blocks[n]->id + 1);
+
+  // one loop per header, the bodies of all its back edges together
+  vector<int> loop_of(size, -1);
+  vector<IrBlock *> &rpo = dom.reverse_postorder();
+  loops.clear();
+  for (size_t n = 0; n < rpo.size(); n++) {
+    IrBlock *b = rpo[n];
+    for (size_t s = 0; s < b->succs.size(); s++) {
+      IrBlock *h = b->succs[s];
+      if (!dom.dominates(h, b))
+        continue;
+      if (loop_of[h->id] < 0) {
+        loop_of[h->id] = loops.size();
+        loops.push_back(Loop());
+        loops.back().header = h;
+        loops.back().body.assign(size, false);
+        loops.back().body[h->id] = true;
+      }
+      Loop &l = loops[loop_of[h->id]];
+      vector<IrBlock *> work;
+      if (!l.body[b->id]) {
+        l.body[b->id] = true;
+        work.push_back(b);
+      }
+      while (!work.empty()) {
+        IrBlock *w = work.back();
+        work.pop_back();
+        for (size_t p = 0; p < w->preds.size(); p++) {
+          if (!l.body[w->preds[p]->id]) {
+            l.body[w->preds[p]->id] = true;
+            work.push_back(w->preds[p]);
+          }
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < loops.size(); i++)
+    for (size_t n = 0; n < rpo.size(); n++)
+      if (loops[i].body[rpo[n]->id])
+        loops[i].blocks.push_back(rpo[n]);
+  stable_sort(loops.begin(), loops.end(), inner_first);
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//    Preheaders
+//
+//  A header entered from more than one block outside the loop, or from
+//  a block that also goes elsewhere, gets a new block placed right
+//  before it in the layout.  The entering blocks go there instead, and
+//  the header's phis take their values from it: from a phi of the
+//  preheader if the values come from several blocks.
+//
+//////////////////////////////////////////////////////////////////
+
+static void add_preheader(IrFunction &f, Loop &l)
+{
+  IrBlock *h = l.header;
+  vector<size_t> outside;
+  for (size_t p = 0; p < h->preds.size(); p++)
+    if (!l.contains(h->preds[p]))
+      outside.push_back(p);
+  if (outside.size() == 1 && h->preds[outside[0]]->succs.size() == 1)
+    return;
+
+  IrBlock *pre = f.new_block();
+  vector<IrBlock *>::iterator at = find(f.blocks.begin(), f.blocks.end(), h);
+  if (at != f.blocks.begin()) {
+    IrBlock *prev = *(at - 1);
+    if (!prev->terminated() && l.contains(prev)) {
+      // the loop falls into the header, now it has to jump over pre
+      prev->insns.push_back(IrInsn(IR_JMP, -1));
+      prev->insns.back().target[0] = h;
+    }
+  }
+  f.blocks.insert(at, pre);
+
+  for (size_t i = 0; i < h->insns.size() && h->insns[i].op == IR_PHI; i++) {
+    IrInsn &phi = h->insns[i];
+    Operand incoming = phi.args[outside[0]];
+    if (outside.size() > 1) {
+      int v = f.is_variable(phi.dst) ? f.new_variable(f.kind(phi.dst)) : f.new_temp(f.kind(phi.dst));
+      IrInsn merge(IR_PHI, v);
+      for (size_t o = 0; o < outside.size(); o++)
+        merge.args.push_back(phi.args[outside[o]]);
+      pre->insns.push_back(merge);
+      incoming = vreg_op(v);
+    }
+    vector<Operand> args(1, incoming);
+    for (size_t p = 0; p < h->preds.size(); p++)
+      if (l.contains(h->preds[p]))
+        args.push_back(phi.args[p]);
+    phi.args = args;
+  }
+
+  vector<IrBlock *> preds(1, pre);
+  for (size_t p = 0; p < h->preds.size(); p++) {
+    IrBlock *pred = h->preds[p];
+    if (l.contains(pred)) {
+      preds.push_back(pred);
+      continue;
+    }
+    pre->preds.push_back(pred);
+    replace(pred->succs.begin(), pred->succs.end(), h, pre);
+    if (pred->terminated())
+      for (int t = 0; t < 2; t++)
+        if (pred->insns.back().target[t] == h)
+          pred->insns.back().target[t] = pre;
+  }
+  pre->succs.push_back(h);
+  h->preds = preds;
+}
+
+void add_preheaders(IrFunction &f)
+{
+  DominatorTree dom(f);
+  vector<Loop> loops;
+  find_loops(f, dom, loops);
+  for (size_t i = 0; i < loops.size(); i++)
+    add_preheader(f, loops[i]);
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//    Loop-invariant code motion
+//
+//////////////////////////////////////////////////////////////////
+
+class Hoister {
+private:
+  IrFunction &f;
+  const set<Symbol> &pure;
+  vector<IrBlock *> def_block;          // indexed by vreg, NULL for paras
+  vector<bool> constant;                // defined by a mov of an immediate
+  vector<long long> value;
+  vector<bool> stored;                  // globals the current loop stores
+  bool calls_impure;
+
+  bool safe(IrInsn &in);
+  bool invariant(Loop &l, const Operand &o);
+
+public:
+  int hoisted;
+
+  Hoister(IrFunction &fn, const set<Symbol> &p);
+  void hoist(Loop &l);
+};
+
+Hoister::Hoister(IrFunction &fn, const set<Symbol> &p)
+  : f(fn), pure(p), def_block(fn.vregs(), NULL), constant(fn.vregs(), false),
+    value(fn.vregs(), 0), calls_impure(false), hoisted(0)
+{
+  for (size_t n = 0; n < f.blocks.size(); n++) {
+    vector<IrInsn> &insns = f.blocks[n]->insns;
+    for (size_t i = 0; i < insns.size(); i++) {
+      IrInsn &in = insns[i];
+      if (in.dst < 0 || f.global(in.dst) != NULL)
+        continue;
+      def_block[in.dst] = f.blocks[n];
+      if (in.op == IR_MOV && in.a.kind == Operand::IMM) {
+        constant[in.dst] = true;
+        value[in.dst] = in.a.value;
+      }
+    }
+  }
+}
+
+// the instruction has no effect and cannot fail wherever it runs
+bool Hoister::safe(IrInsn &in)
+{
+  if (in.dst < 0 || f.global(in.dst) != NULL)
+    return false;
+  switch (in.op) {
+  case IR_ADD:
+  case IR_SUB:
+  case IR_MUL:
+  case IR_AND:
+  case IR_OR:
+  case IR_XOR:
+  case IR_NEG:
+  case IR_NOT:
+  case IR_FADD:
+  case IR_FSUB:
+  case IR_FMUL:
+  case IR_FDIV:
+  case IR_FNEG:
+  case IR_I2F:
+  case IR_FCONST:
+  case IR_LEA:
+  case IR_SET:
+    return true;
+  case IR_DIV:
+  case IR_MOD:
+    // idivq faults on 0, and on -1 when the dividend is the least Int
+    return in.b.kind == Operand::VREG && constant[in.b.vreg] &&
+           value[in.b.vreg] != 0 && value[in.b.vreg] != -1;
+  case IR_CALL:
+    return pure.count(in.name) > 0;
+  default:
+    // an immediate is cheaper to load again than to keep in a register
+    return false;
+  }
+}
+
+// constants defined in the loop count, hoist() loads them again
+bool Hoister::invariant(Loop &l, const Operand &o)
+{
+  if (o.kind != Operand::VREG)
+    return true;
+  if (f.global(o.vreg) != NULL)
+    return !stored[o.vreg] && !calls_impure;
+  return def_block[o.vreg] == NULL || !l.contains(def_block[o.vreg]) || constant[o.vreg];
+}
+
+void Hoister::hoist(Loop &l)
+{
+  IrBlock *pre = NULL;
+  for (size_t p = 0; p < l.header->preds.size(); p++)
+    if (!l.contains(l.header->preds[p]))
+      pre = l.header->preds[p];
+
+  stored.assign(f.vregs(), false);
+  calls_impure = false;
+  for (size_t n = 0; n < l.blocks.size(); n++) {
+    vector<IrInsn> &insns = l.blocks[n]->insns;
+    for (size_t i = 0; i < insns.size(); i++) {
+      if (insns[i].dst >= 0 && f.global(insns[i].dst) != NULL)
+        stored[insns[i].dst] = true;
+      if (insns[i].op == IR_CALL && pure.count(insns[i].name) == 0)
+        calls_impure = true;
+    }
+  }
+
+  // in reverse postorder a value is hoisted before the ones using it
+  vector<Operand *> ops;
+  for (size_t n = 0; n < l.blocks.size(); n++) {
+    vector<IrInsn> kept;
+    vector<IrInsn> &insns = l.blocks[n]->insns;
+    for (size_t i = 0; i < insns.size(); i++) {
+      IrInsn &in = insns[i];
+      bool movable = safe(in);
+      in.operands(ops);
+      for (size_t o = 0; o < ops.size() && movable; o++)
+        movable = invariant(l, *ops[o]);
+      if (!movable) {
+        kept.push_back(in);
+        continue;
+      }
+      vector<IrInsn> &to = pre->insns;
+      for (size_t o = 0; o < ops.size(); o++) {
+        int v = ops[o]->kind == Operand::VREG ? ops[o]->vreg : -1;
+        if (v < 0 || f.global(v) != NULL || def_block[v] == NULL || !l.contains(def_block[v]))
+          continue;
+        int t = f.new_temp(f.kind(v));
+        IrInsn load(IR_MOV, t);
+        load.a = imm_op(value[v]);
+        to.insert(pre->terminated() ? to.end() - 1 : to.end(), load);
+        def_block.push_back(pre);
+        constant.push_back(true);
+        value.push_back(value[v]);
+        ops[o]->vreg = t;
+      }
+      to.insert(pre->terminated() ? to.end() - 1 : to.end(), in);
+      def_block[in.dst] = pre;
+      hoisted++;
+    }
+    insns.swap(kept);
+  }
+}
+
+int hoist_invariants(IrFunction &f, const set<Symbol> &pure)
+{
+  add_preheaders(f);
+  DominatorTree dom(f);
+  vector<Loop> loops;
+  find_loops(f, dom, loops);
+  Hoister h(f, pure);
+  for (size_t i = 0; i < loops.size(); i++)
+    h.hoist(loops[i]);
+  return h.hoisted;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//    Loop unrolling
+//
+//  Before SSA form, on loops the way ForStmt_class::lower leaves them: a
+//  header that only tests a local i against a bound n, entered from one
+//  block outside, and one latch that adds a constant step to i and jumps
+//  back.  Nothing else in the loop writes i or n, so whether the test
+//  passes only depends on the number of steps taken, and k iterations in
+//  a row are safe once i + (k-1)*step passes it.  Copies of the body get
+//  fall throughs made explicit, their jumps to the header go to the next
+//  copy and everything else, breaks included, stays where it went.
+//
+//////////////////////////////////////////////////////////////////
+
+static const Relation SWAPPED[] = {REL_GT, REL_GE, REL_EQ, REL_NE, REL_LE, REL_LT};
+
+struct CountedLoop {
+  IrBlock *header, *pre, *latch, *entry, *exit;
+  vector<IrBlock *> blocks;             // all but the header, in layout order
+  size_t size;                          // instructions in blocks
+  int var;                              // the loop runs while var rel bound
+  Relation rel;
+  Operand bound;
+  long long step;
+};
+
+static bool counted_loop(IrFunction &f, Loop &l, CountedLoop &c)
+{
+  IrBlock *h = l.header;
+  if (h->insns.size() != 1 || h->insns[0].op != IR_BR)
+    return false;
+  IrInsn &test = h->insns[0];
+  if (!l.contains(test.target[0]) || l.contains(test.target[1]))
+    return false;
+  c.header = h;
+  c.entry = test.target[0];
+  c.exit = test.target[1];
+  c.pre = c.latch = NULL;
+  for (size_t p = 0; p < h->preds.size(); p++) {
+    IrBlock *&from = l.contains(h->preds[p]) ? c.latch : c.pre;
+    if (from != NULL)
+      return false;
+    from = h->preds[p];
+  }
+  if (c.pre == NULL || c.latch == NULL || c.latch->insns.size() != 2 ||
+      c.latch->insns[1].op != IR_JMP)
+    return false;
+
+  // the latch steps a local: i = i + c, i = c + i or i = i - c
+  IrInsn &step = c.latch->insns[0];
+  c.var = step.dst;
+  if (c.var < 0 || !f.is_variable(c.var) || f.global(c.var) != NULL || f.is_float(c.var))
+    return false;
+  bool a_self = step.a.kind == Operand::VREG && step.a.vreg == c.var;
+  bool b_self = step.b.kind == Operand::VREG && step.b.vreg == c.var;
+  Operand by;
+  if ((step.op == IR_ADD || step.op == IR_SUB) && a_self)
+    by = step.b;
+  else if (step.op == IR_ADD && b_self)
+    by = step.a;
+  // a step within 32 bits can be negated and multiplied by the small
+  // counts below without wrapping
+  if (by.kind != Operand::IMM || !fits_imm(by.value))
+    return false;
+  c.step = step.op == IR_SUB ? -by.value : by.value;
+
+  if (test.a.kind == Operand::VREG && test.a.vreg == c.var) {
+    c.rel = test.rel;
+    c.bound = test.b;
+  } else if (test.b.kind == Operand::VREG && test.b.vreg == c.var) {
+    c.rel = SWAPPED[test.rel];
+    c.bound = test.a;
+  } else {
+    return false;
+  }
+  // counting towards the bound, never away from it
+  bool up = c.rel == REL_LT || c.rel == REL_LE;
+  bool down = c.rel == REL_GT || c.rel == REL_GE;
+  if (!(up && c.step > 0) && !(down && c.step < 0))
+    return false;
+  bool bound_reg = c.bound.kind == Operand::VREG;
+  if (bound_reg && (c.bound.vreg == c.var || f.is_float(c.bound.vreg)))
+    return false;
+
+  c.blocks.clear();
+  c.size = 0;
+  for (size_t n = 0; n < f.blocks.size(); n++) {
+    IrBlock *b = f.blocks[n];
+    if (b == h || !l.contains(b))
+      continue;
+    c.blocks.push_back(b);
+    c.size += b->insns.size();
+    for (size_t i = 0; i < b->insns.size(); i++) {
+      IrInsn &in = b->insns[i];
+      if (in.dst == c.var && &in != &step)
+        return false;
+      if (bound_reg && (in.dst == c.bound.vreg ||
+                        (in.op == IR_CALL && f.global(c.bound.vreg) != NULL)))
+        return false;
+    }
+  }
+  return true;
+}
+
+// the number of times c runs, false if that is not known or would wrap i
+static bool trip_count(CountedLoop &c, long long &trips)
+{
+  if (c.bound.kind != Operand::IMM)
+    return false;
+  vector<IrInsn> &insns = c.pre->insns;
+  size_t i = insns.size();
+  while (i > 0 && insns[i - 1].dst != c.var)
+    i--;
+  if (i == 0 || insns[i - 1].op != IR_MOV || insns[i - 1].a.kind != Operand::IMM)
+    return false;
+  long long start = insns[i - 1].a.value, bound = c.bound.value;
+
+  bool up = c.step > 0;
+  unsigned long long step = up ? c.step : -c.step;
+  unsigned long long distance = up ? (unsigned long long) bound - start
+                                   : (unsigned long long) start - bound;
+  if (up ? start > bound : start < bound)
+    trips = 0;
+  else if (c.rel == REL_LE || c.rel == REL_GE)
+    trips = distance / step + 1;
+  else if (start == bound)
+    trips = 0;
+  else
+    trips = (distance - 1) / step + 1;
+  if (trips < 0 || trips > INT32_MAX)
+    return false;
+  // the last step must not wrap either
+  unsigned long long room = up ? (unsigned long long) INT64_MAX - start
+                               : (unsigned long long) start - INT64_MIN;
+  return (unsigned long long) trips <= room / step;
+}
+
+// copies of the body of c placed at the end of layout, its jumps to the
+// header going to next; returns the copy of the entry
+static IrBlock *copy_body(IrFunction &f, CountedLoop &c, IrBlock *next, vector<IrBlock *> &layout)
+{
+  map<IrBlock *, IrBlock *> copy;
+  for (size_t n = 0; n < c.blocks.size(); n++)
+    copy[c.blocks[n]] = f.new_block();
+  for (size_t n = 0; n < c.blocks.size(); n++) {
+    IrBlock *b = c.blocks[n];
+    IrBlock *to = copy[b];
+    to->insns = b->insns;
+    if (!b->terminated()) {
+      to->insns.push_back(IrInsn(IR_JMP, -1));
+      to->insns.back().target[0] = b->succs[0];
+    }
+    IrInsn &last = to->insns.back();
+    for (int t = 0; t < 2; t++) {
+      if (last.target[t] == c.header)
+        last.target[t] = next;
+      else if (copy.count(last.target[t]))
+        last.target[t] = copy[last.target[t]];
+    }
+    layout.push_back(to);
+  }
+  return copy[c.entry];
+}
+
+// copies chained one after the other, the last going to next
+static IrBlock *copy_bodies(IrFunction &f, CountedLoop &c, long long copies, IrBlock *next,
+                            vector<IrBlock *> &layout)
+{
+  vector<vector<IrBlock *> > chain(copies);
+  for (long long j = copies - 1; j >= 0; j--)
+    next = copy_body(f, c, next, chain[j]);
+  for (long long j = 0; j < copies; j++)
+    layout.insert(layout.end(), chain[j].begin(), chain[j].end());
+  return next;
+}
+
+// enter at the first block of layout instead of the header
+static void enter(IrFunction &f, CountedLoop &c, vector<IrBlock *> &layout)
+{
+  if (c.pre->terminated()) {
+    IrInsn &last = c.pre->insns.back();
+    for (int t = 0; t < 2; t++)
+      if (last.target[t] == c.header)
+        last.target[t] = layout[0];
+  }
+  // a pre that falls through sits right before the header
+  f.blocks.insert(find(f.blocks.begin(), f.blocks.end(), c.header), layout.begin(), layout.end());
+}
+
+//
+// factor copies per test of i against a limit moved back by
+// (factor-1) steps, the original loop doing the remaining iterations.
+// A bound in a register is checked first: if moving it back would wrap,
+// only the original loop runs.
+//
+static bool unroll(IrFunction &f, CountedLoop &c, int factor)
+{
+  if (c.step > INT32_MAX / (factor - 1) || c.step < INT32_MIN / (factor - 1))
+    return false;
+  long long back = (long long) (factor - 1) * c.step;
+  bool up = c.step > 0;
+  vector<IrBlock *> layout;
+  IrBlock *guard = f.new_block();
+  Operand limit;
+  if (c.bound.kind == Operand::IMM) {
+    if (up ? c.bound.value < INT64_MIN + back : c.bound.value > INT64_MAX + back)
+      return false;
+    limit = imm_op(c.bound.value - back);
+    if (!fits_imm(limit.value))
+      return false;
+  } else {
+    IrBlock *check = f.new_block();
+    IrBlock *setup = f.new_block();
+    int edge = f.new_temp(TYPE_INT);
+    IrInsn mov(IR_MOV, edge);
+    mov.a = imm_op(up ? INT64_MIN + back : INT64_MAX + back);
+    check->insns.push_back(mov);
+    IrInsn br(IR_BR, -1);
+    br.rel = up ? REL_LT : REL_GT;
+    br.a = c.bound;
+    br.b = vreg_op(edge);
+    br.target[0] = c.header;
+    br.target[1] = setup;
+    check->insns.push_back(br);
+    limit = vreg_op(f.new_temp(TYPE_INT));
+    IrInsn sub(IR_SUB, limit.vreg);
+    sub.a = c.bound;
+    sub.b = imm_op(back);
+    setup->insns.push_back(sub);
+    layout.push_back(check);
+    layout.push_back(setup);
+  }
+  layout.push_back(guard);
+  IrInsn br(IR_BR, -1);
+  br.rel = c.rel;
+  br.a = vreg_op(c.var);
+  br.b = limit;
+  br.target[1] = c.header;
+  guard->insns.push_back(br);
+  guard->insns.back().target[0] = copy_bodies(f, c, factor, guard, layout);
+  enter(f, c, layout);
+  return true;
+}
+
+int unroll_loops(IrFunction &f, int factor, int max_trips, size_t max_insns)
+{
+  DominatorTree dom(f);
+  vector<Loop> loops;
+  find_loops(f, dom, loops);
+  int size = 0;
+  for (size_t n = 0; n < f.blocks.size(); n++)
+    size = max(size, f.blocks[n]->id + 1);
+  vector<bool> header(size, false);
+  for (size_t i = 0; i < loops.size(); i++)
+    header[loops[i].header->id] = true;
+
+  int unrolled = 0;
+  for (size_t i = 0; i < loops.size(); i++) {
+    // innermost loops only, so the loops changed never overlap
+    bool inner = true;
+    for (size_t n = 1; n < loops[i].blocks.size(); n++)
+      inner = inner && !header[loops[i].blocks[n]->id];
+    CountedLoop c;
+    if (!inner || !counted_loop(f, loops[i], c))
+      continue;
+    long long trips = -1;
+    bool known = trip_count(c, trips);
+    if (known && trips == 0)
+      continue;
+    if (known && trips <= max_trips && (size_t) trips * c.size <= max_insns) {
+      vector<IrBlock *> layout;
+      copy_bodies(f, c, trips, c.exit, layout);
+      enter(f, c, layout);
+      unrolled++;
+    } else if (factor > 1 && (!known || trips >= factor) &&
+               (size_t) factor * c.size <= max_insns && unroll(f, c, factor)) {
+      unrolled++;
+    }
+  }
+  if (unrolled > 0)
+    f.link();
+  return unrolled;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//    Loop rotation
+//
+//  Out of SSA form a register may be written anywhere, so replacing a
+//  jmp to the header by the header's own instructions changes nothing
+//  but the number of branches taken.
+//
+//////////////////////////////////////////////////////////////////
+
+int rotate_loops(IrFunction &f, size_t max_rotated)
+{
+  DominatorTree dom(f);
+  vector<Loop> loops;
+  find_loops(f, dom, loops);
+  int rotated = 0;
+  for (size_t i = 0; i < loops.size(); i++) {
+    IrBlock *h = loops[i].header;
+    if (h->insns.empty() || h->insns.size() > max_rotated || h->insns.back().op != IR_BR)
+      continue;
+    IrInsn &test = h->insns.back();
+    if (loops[i].contains(test.target[0]) == loops[i].contains(test.target[1]))
+      continue;
+    bool any = false;
+    for (size_t p = 0; p < h->preds.size(); p++) {
+      IrBlock *latch = h->preds[p];
+      if (!loops[i].contains(latch) || !latch->terminated() || latch->insns.back().op != IR_JMP)
+        continue;
+      latch->insns.pop_back();
+      latch->insns.insert(latch->insns.end(), h->insns.begin(), h->insns.end());
+      any = true;
+    }
+    rotated += any;
+  }
+  f.link();
+  return rotated;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//    Pure functions
+//
+//////////////////////////////////////////////////////////////////
+
+void call_facts(IrFunction &f, CallFacts &facts)
+{
+  facts.name = f.name;
+  facts.pure_body = true;
+  facts.callees.clear();
+  for (int v = 0; v < f.vregs(); v++)
+    if (f.global(v) != NULL)
+      facts.pure_body = false;
+  for (size_t n = 0; n < f.blocks.size(); n++) {
+    vector<IrInsn> &insns = f.blocks[n]->insns;
+    for (size_t i = 0; i < insns.size(); i++) {
+      if (insns[i].op == IR_DIV || insns[i].op == IR_MOD)
+        facts.pure_body = false;
+      if (insns[i].op == IR_CALL)
+        facts.callees.push_back(insns[i].name);
+    }
+  }
+  if (facts.pure_body) {
+    DominatorTree dom(f);
+    vector<Loop> loops;
+    find_loops(f, dom, loops);
+    facts.pure_body = loops.empty();
+  }
+}
+
+void find_pure(vector<CallFacts> &facts, set<Symbol> &pure)
+{
+  // only what is proven goes in, so a cycle of calls never does
+  pure.clear();
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t i = 0; i < facts.size(); i++) {
+      if (!facts[i].pure_body || pure.count(facts[i].name))
+        continue;
+      bool all = true;
+      for (size_t c = 0; c < facts[i].callees.size() && all; c++)
+        all = pure.count(facts[i].callees[c]) > 0;
+      if (all) {
+        pure.insert(facts[i].name);
+        changed = true;
+      }
+    }
+  }
+}
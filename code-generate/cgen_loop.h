@@ -0,0 +1,85 @@
+#ifndef CGEN_LOOP_H
+#define CGEN_LOOP_H
+
+//
+// Loop optimizations on the SSA form of the three-address code.
+//
+// A natural loop is found from each back edge, an edge whose target
+// dominates its source: the target is the header, the body everything
+// that reaches the source without passing the header.  Loops sharing a
+// header are one loop.
+//
+// hoist_invariants() moves instructions whose operands do not change in a
+// loop to its preheader, the single block that enters the header from
+// outside.  Only operations that cannot trap are moved, since the
+// preheader runs even when the body does not: Int and Float arithmetic,
+// conversions, comparisons, divisions by a constant other than 0 and -1,
+// and calls to pure functions.  Reads of a global stay unless the loop
+// neither stores to it nor calls anything impure.
+//
+
+#include <set>
+#include <vector>
+#include "cgen_ir.h"
+
+class DominatorTree;
+
+struct Loop {
+  IrBlock *header;
+  std::vector<IrBlock *> blocks;        // in reverse postorder, header first
+  std::vector<bool> body;               // indexed by block id
+
+  bool contains(IrBlock *b) { return b->id < (int) body.size() && body[b->id]; }
+};
+
+// the natural loops of f, inner loops before the loops containing them
+void find_loops(IrFunction &f, DominatorTree &dom, std::vector<Loop> &loops);
+
+// give every loop header a preheader, keeping phi arguments in step
+void add_preheaders(IrFunction &f);
+
+// returns the number of instructions hoisted
+int hoist_invariants(IrFunction &f, const std::set<Symbol> &pure);
+
+//
+// Loop unrolling, on f before it enters SSA form.  A loop counting a
+// local i by a constant step towards a bound that does not change in it,
+// the shape of most for loops, runs factor copies of its body for each
+// test, the original loop doing what is left over.  If i starts at a
+// constant and the bound is one, a loop running at most max_trips times
+// becomes that many copies of its body with no test at all.  Only
+// innermost loops are unrolled, and only while the copies come to at
+// most max_insns instructions.  Returns the number of loops unrolled.
+//
+int unroll_loops(IrFunction &f, int factor, int max_trips, size_t max_insns);
+
+//
+// Loop rotation, on f after it has left SSA form.  A loop is lowered
+// with its test at the top and a jump back to it at the bottom, two
+// branches per iteration.  Every jump back to a header that ends in the
+// loop's conditional branch gets a copy of the header instead, so the
+// header itself only runs as the guard on entry and each iteration ends
+// in one conditional branch back to the top of the body.  A continue is
+// a jump back like any other and tests right where it is.  Headers of
+// more than max_rotated instructions are left alone.  Returns the number
+// of loops rotated.
+//
+int rotate_loops(IrFunction &f, size_t max_rotated);
+
+//
+// A function is pure if it reads and writes no global, never divides,
+// has no loop and calls only pure functions: a call to it always returns
+// the same value for the same arguments, has no effect and cannot fail,
+// so it can be made in the preheader.  Recursive functions are never
+// proven pure.
+//
+struct CallFacts {
+  Symbol name;
+  bool pure_body;                       // pure but for the calls
+  std::vector<Symbol> callees;
+};
+
+void call_facts(IrFunction &f, CallFacts &facts);
+void find_pure(std::vector<CallFacts> &facts, std::set<Symbol> &pure);
+
+#endif
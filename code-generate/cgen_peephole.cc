@@ -0,0 +1,279 @@
+//**************************************************************
+//
+// Peephole optimizer over the emitted assembly.
+//
+//**************************************************************
+
+#include <sstream>
+#include "cgen_peephole.h"
+
+using namespace std;
+
+static string trim(const string &s)
+{
+  size_t b = s.find_first_not_of(" \t");
+  if (b == string::npos)
+    return "";
+  size_t e = s.find_last_not_of(" \t");
+  return s.substr(b, e - b + 1);
+}
+
+Insn::Insn(const string &line) : text(line)
+{
+  string t = trim(line);
+  if (line.size() > 0 && line[0] != '\t' && line[0] != ' ' &&
+      t.size() > 0 && t[t.size() - 1] == ':') {
+    label = t.substr(0, t.size() - 1);
+    return;
+  }
+
+  size_t space = t.find_first_of(" \t");
+  op = t.substr(0, space);
+  if (space == string::npos)
+    return;
+  string rest = t.substr(space);
+  size_t start = 0;
+  while (start <= rest.size()) {
+    size_t comma = rest.find(',', start);
+    if (comma == string::npos)
+      comma = rest.size();
+    string arg = trim(rest.substr(start, comma - start));
+    if (!arg.empty())
+      args.push_back(arg);
+    start = comma + 1;
+  }
+}
+
+void Insn::set(const string &o, const string &a1, const string &a2)
+{
+  op = o;
+  args.clear();
+  args.push_back(a1);
+  args.push_back(a2);
+  text = "\t" + o + "\t" + a1 + ", " + a2;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//    Rules
+//
+//  Each rule looks at the instructions starting at i and returns how
+//  many of them it removed or rewrote, 0 if it did not apply.
+//
+//////////////////////////////////////////////////////////////////
+
+static bool is_move(const Insn &in)
+{
+  return in.args.size() == 2 && (in.op == "movq" || in.op == "movsd" || in.op == "movaps");
+}
+
+static bool is_mem(const string &arg)
+{
+  return arg.find('(') != string::npos;
+}
+
+static bool is_reg(const string &arg)
+{
+  return !arg.empty() && arg[0] == '%';
+}
+
+// both moves copy the same kind of value
+static bool same_class(const Insn &a, const Insn &b)
+{
+  return (a.op == "movq") == (b.op == "movq");
+}
+
+// the next instruction, skipping nothing; NULL at the end
+static Insn *next(vector<Insn> &code, size_t i)
+{
+  return i + 1 < code.size() ? &code[i + 1] : NULL;
+}
+
+//
+// mov a, b followed by mov b, a is redundant, a value stored to memory is
+// read back from the register it came from, and a move onto itself does
+// nothing.
+//
+static int forward_stores(vector<Insn> &code, size_t i)
+{
+  Insn &first = code[i];
+  if (!is_move(first))
+    return 0;
+  if (first.args[0] == first.args[1]) {
+    code.erase(code.begin() + i);
+    return 1;
+  }
+
+  Insn *second = next(code, i);
+  if (second == NULL || !is_move(*second) || !same_class(first, *second))
+    return 0;
+  if (second->args[0] == first.args[1] && second->args[1] == first.args[0]) {
+    code.erase(code.begin() + i + 1);
+    return 1;
+  }
+  if (second->args[0] == first.args[1] && is_mem(first.args[1]) &&
+      !is_mem(first.args[0]) && is_reg(second->args[1])) {
+    if (first.op == "movq")
+      second->set("movq", first.args[0], second->args[1]);
+    else
+      second->set("movaps", first.args[0], second->args[1]);
+    return 1;
+  }
+  return 0;
+}
+
+//
+// A move whose destination is overwritten by the next move, without being
+// read by it, stores a value nobody sees.
+//
+static int remove_dead_stores(vector<Insn> &code, size_t i)
+{
+  Insn &first = code[i];
+  Insn *second = next(code, i);
+  if (!is_move(first) || second == NULL || !is_move(*second) || !same_class(first, *second))
+    return 0;
+  const string &dest = first.args[1];
+  if (second->args[1] != dest || second->args[0].find(dest) != string::npos)
+    return 0;
+  code.erase(code.begin() + i);
+  return 1;
+}
+
+// a jmp to a label that directly follows it, maybe after an alignment
+static int remove_jump_to_next(vector<Insn> &code, size_t i)
+{
+  Insn &jump = code[i];
+  if (jump.op != "jmp" || jump.args.size() != 1)
+    return 0;
+  for (size_t j = i + 1; j < code.size() && (code[j].is_label() || code[j].is_directive()); j++) {
+    if (code[j].label == jump.args[0]) {
+      code.erase(code.begin() + i);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// nothing after a ret or jmp runs until the next label
+static int remove_unreachable(vector<Insn> &code, size_t i)
+{
+  if (code[i].op != "ret" && code[i].op != "jmp")
+    return 0;
+  size_t j = i + 1;
+  while (j < code.size() && !code[j].is_label() && !code[j].is_directive())
+    j++;
+  code.erase(code.begin() + i + 1, code.begin() + j);
+  return j - (i + 1);
+}
+
+static const char *REG64[] = {"%rax", "%rbx", "%rcx", "%rdx", "%rsi", "%rdi",
+                              "%r8", "%r9", "%r10", "%r11", "%r12", "%r13", "%r14", "%r15"};
+static const char *REG32[] = {"%eax", "%ebx", "%ecx", "%edx", "%esi", "%edi",
+                              "%r8d", "%r9d", "%r10d", "%r11d", "%r12d", "%r13d", "%r14d", "%r15d"};
+
+static bool reads_flags(const string &op)
+{
+  return (!op.empty() && op[0] == 'j' && op != "jmp") || op.compare(0, 3, "set") == 0 ||
+         op.compare(0, 4, "cmov") == 0 || op.compare(0, 3, "adc") == 0 ||
+         op.compare(0, 3, "sbb") == 0;
+}
+
+static bool ends_with(const string &s, const char *suffix)
+{
+  string t(suffix);
+  return s.size() >= t.size() && s.compare(s.size() - t.size(), t.size(), t) == 0;
+}
+
+// sse arithmetic leaves the flags alone, only the compares set them
+static bool writes_flags(const string &op)
+{
+  if (ends_with(op, "sd") || ends_with(op, "pd") || ends_with(op, "ps"))
+    return op == "ucomisd";
+  static const char *WRITERS[] = {"cmp", "test", "add", "sub", "and", "or", "xor",
+                                  "imul", "neg", "ucomisd", "sal", "sar", "shl", "shr"};
+  for (size_t w = 0; w < sizeof(WRITERS) / sizeof(char *); w++)
+    if (op.compare(0, string(WRITERS[w]).size(), WRITERS[w]) == 0)
+      return true;
+  return false;
+}
+
+//
+// movq $0, %reg becomes xorl %reg32, %reg32, which is shorter but clobbers
+// the flags, so only where nothing reads them before they are set again.
+//
+static int use_zero_idioms(vector<Insn> &code, size_t i)
+{
+  Insn &in = code[i];
+  if (in.op != "movq" || in.args.size() != 2 || in.args[0] != "$0")
+    return 0;
+  const char *reg32 = NULL;
+  for (size_t r = 0; r < sizeof(REG64) / sizeof(char *); r++)
+    if (in.args[1] == REG64[r])
+      reg32 = REG32[r];
+  if (reg32 == NULL)
+    return 0;
+
+  for (size_t j = i + 1; j < code.size(); j++) {
+    const Insn &after = code[j];
+    if (after.is_label() || after.is_directive() || after.op == "jmp" ||
+        after.op == "ret" || after.op == "call")
+      break;
+    if (reads_flags(after.op))
+      return 0;
+    if (writes_flags(after.op))
+      break;
+  }
+  in.set("xorl", reg32, reg32);
+  return 1;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//    Peephole
+//
+//////////////////////////////////////////////////////////////////
+
+Peephole::Peephole()
+{
+  static const Entry TABLE[] = {
+    {"store-to-load forwarding", forward_stores, 0},
+    {"dead-store removal", remove_dead_stores, 0},
+    {"jump-to-next elimination", remove_jump_to_next, 0},
+    {"unreachable code after ret/jmp", remove_unreachable, 0},
+    {"zero idioms", use_zero_idioms, 0},
+  };
+  rules.assign(TABLE, TABLE + sizeof(TABLE) / sizeof(Entry));
+}
+
+void Peephole::run(const string &text, ostream &s)
+{
+  vector<Insn> code;
+  istringstream in(text);
+  string line;
+  while (getline(in, line))
+    code.push_back(Insn(line));
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t i = 0; i < code.size(); i++) {
+      for (size_t r = 0; r < rules.size() && i < code.size(); r++) {
+        int n = rules[r].rule(code, i);
+        if (n > 0) {
+          rules[r].removed += n;
+          changed = true;
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < code.size(); i++)
+    s << code[i].text << '\n';
+}
+
+void Peephole::report(ostream &s)
+{
+  for (size_t r = 0; r < rules.size(); r++)
+    s << "Peephole " << rules[r].name << ": " << rules[r].removed
+      << " instructions" << endl;
+}
@@ -0,0 +1,54 @@
+#ifndef CGEN_PEEPHOLE_H
+#define CGEN_PEEPHOLE_H
+
+//
+// Peephole optimization of the emitted assembly, enabled by -O.
+//
+// A function is coded into a buffer first.  The buffer is split into
+// instructions, and the rules in the rule table are tried at every
+// instruction until none of them applies any more.  Only then does the
+// function reach the output stream.
+//
+// The rules rely on two properties of the code generator: the flags are
+// never live across a label or a jump, and %rax, %rdx, %xmm0 and %xmm1 are
+// scratch registers that do not carry values between statements.
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct Insn {
+  std::string text;                 // the line as emitted
+  std::string op;                   // opcode, empty for labels
+  std::vector<std::string> args;    // operands in AT&T order
+  std::string label;                // name of a label line
+
+  Insn(const std::string &line);
+  bool is_label() const { return !label.empty(); }
+  bool is_directive() const { return !op.empty() && op[0] == '.'; }
+  void set(const std::string &o, const std::string &a1, const std::string &a2);
+};
+
+class Peephole {
+public:
+  typedef int (*Rule)(std::vector<Insn> &code, size_t i);
+
+private:
+  struct Entry {
+    const char *name;
+    Rule rule;
+    int removed;
+  };
+  std::vector<Entry> rules;
+
+public:
+  Peephole();
+
+  // optimize the code of one function and write it to s
+  void run(const std::string &code, std::ostream &s);
+  // how many instructions each rule removed or rewrote
+  void report(std::ostream &s);
+};
+
+#endif
@@ -0,0 +1,255 @@
+//**************************************************************
+//
+// Live intervals and linear scan register allocation.
+//
+//**************************************************************
+
+#include <algorithm>
+#include <map>
+#include "cgen_regalloc.h"
+
+//////////////////////////////////////////////////////////////////
+//
+//    Live intervals
+//
+//////////////////////////////////////////////////////////////////
+
+void liveness(IrFunction &f, std::vector<std::vector<bool> > &live_in,
+              std::vector<std::vector<bool> > &live_out)
+{
+  int n = f.blocks.size();
+  int vregs = f.vregs();
+  std::vector<std::vector<bool> > uses(n, std::vector<bool>(vregs, false));
+  std::vector<std::vector<bool> > defs(n, std::vector<bool>(vregs, false));
+  std::vector<Operand *> ops;
+  for (int b = 0; b < n; b++) {
+    std::vector<IrInsn> &insns = f.blocks[b]->insns;
+    for (size_t i = 0; i < insns.size(); i++) {
+      insns[i].operands(ops);
+      for (size_t o = 0; o < ops.size(); o++) {
+        int v = ops[o]->vreg;
+        if (ops[o]->kind == Operand::VREG && f.global(v) == NULL && !defs[b][v])
+          uses[b][v] = true;
+      }
+      if (insns[i].dst >= 0)
+        defs[b][insns[i].dst] = true;
+    }
+  }
+
+  std::map<IrBlock *, int> index;
+  for (int b = 0; b < n; b++)
+    index[f.blocks[b]] = b;
+  live_in.assign(n, std::vector<bool>(vregs, false));
+  live_out.assign(n, std::vector<bool>(vregs, false));
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int b = n - 1; b >= 0; b--) {
+      std::vector<IrBlock *> &succs = f.blocks[b]->succs;
+      for (size_t s = 0; s < succs.size(); s++) {
+        std::vector<bool> &in = live_in[index[succs[s]]];
+        for (int v = 0; v < vregs; v++)
+          live_out[b][v] = live_out[b][v] || in[v];
+      }
+      for (int v = 0; v < vregs; v++) {
+        bool live = uses[b][v] || (live_out[b][v] && !defs[b][v]);
+        if (live && !live_in[b][v]) {
+          live_in[b][v] = true;
+          changed = true;
+        }
+      }
+    }
+  }
+}
+
+void IntervalBuilder::extend(int vreg, int pos)
+{
+  LiveInterval &i = intervals[vreg];
+  if (i.start < 0 || pos < i.start)
+    i.start = pos;
+  if (pos > i.end)
+    i.end = pos;
+}
+
+IntervalBuilder::IntervalBuilder(IrFunction &f)
+{
+  for (int v = 0; v < f.vregs(); v++) {
+    intervals.push_back(LiveInterval(v, f.is_float(v)));
+    intervals[v].fixed = f.global(v) != NULL;
+  }
+  if (f.blocks.empty())
+    return;
+
+  std::vector<std::vector<bool> > live_in, live_out;
+  liveness(f, live_in, live_out);
+  for (size_t p = 0; p < f.params.size(); p++)
+    if (live_in[0][f.params[p]])
+      extend(f.params[p], 0);
+
+  int pos = 0;
+  std::vector<Operand *> ops;
+  for (size_t b = 0; b < f.blocks.size(); b++) {
+    int first = ++pos;
+    std::vector<IrInsn> &insns = f.blocks[b]->insns;
+    for (size_t i = 0; i < insns.size(); i++) {
+      ++pos;
+      insns[i].operands(ops);
+      for (size_t o = 0; o < ops.size(); o++)
+        if (ops[o]->kind == Operand::VREG && !intervals[ops[o]->vreg].fixed)
+          extend(ops[o]->vreg, pos);
+      if (insns[i].dst >= 0 && !intervals[insns[i].dst].fixed)
+        extend(insns[i].dst, pos);
+      if (insns[i].op == IR_CALL)
+        calls.push_back(pos);
+    }
+    for (int v = 0; v < f.vregs(); v++) {
+      if (live_in[b][v])
+        extend(v, first);
+      if (live_out[b][v])
+        extend(v, pos);
+    }
+  }
+
+  for (size_t v = 0; v < intervals.size(); v++) {
+    LiveInterval &i = intervals[v];
+    if (i.fixed || !i.used())
+      continue;
+    std::vector<int>::iterator c = std::upper_bound(calls.begin(), calls.end(), i.start);
+    i.crosses_call = c != calls.end() && *c < i.end;
+  }
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//    LinearScan
+//
+//////////////////////////////////////////////////////////////////
+
+LinearScan::LinearScan(const char **callee, int ncallee, const char **caller, int ncaller)
+  : callee_saved(callee, callee + ncallee), caller_saved(caller, caller + ncaller),
+    allocated(0), spilled(0)
+{
+  free_regs.insert(free_regs.end(), caller_saved.begin(), caller_saved.end());
+  free_regs.insert(free_regs.end(), callee_saved.begin(), callee_saved.end());
+}
+
+static bool by_start(LiveInterval *a, LiveInterval *b)
+{
+  return a->start < b->start || (a->start == b->start && a->vreg < b->vreg);
+}
+
+// intervals sharing a position overlap, so only those ending before start
+// give their register back
+void LinearScan::expire(int start)
+{
+  size_t n = 0;
+  while (n < active.size() && active[n]->end < start) {
+    free_regs.push_back(active[n]->reg);
+    n++;
+  }
+  active.erase(active.begin(), active.begin() + n);
+}
+
+const char *LinearScan::take_free(bool callee_only)
+{
+  for (int pass = callee_only ? 1 : 0; pass < 2; pass++) {
+    std::vector<const char *> &order = pass == 0 ? caller_saved : callee_saved;
+    for (size_t r = 0; r < order.size(); r++) {
+      std::vector<const char *>::iterator it = std::find(free_regs.begin(), free_regs.end(), order[r]);
+      if (it != free_regs.end()) {
+        free_regs.erase(it);
+        return order[r];
+      }
+    }
+  }
+  return NULL;
+}
+
+bool LinearScan::may_hold(LiveInterval *i, const char *reg)
+{
+  if (!i->crosses_call)
+    return true;
+  return std::find(callee_saved.begin(), callee_saved.end(), reg) != callee_saved.end();
+}
+
+void LinearScan::add_active(LiveInterval *i)
+{
+  std::vector<LiveInterval *>::iterator it = active.begin();
+  while (it != active.end() && (*it)->end <= i->end)
+    ++it;
+  active.insert(it, i);
+}
+
+void LinearScan::run(std::vector<LiveInterval *> &intervals)
+{
+  std::sort(intervals.begin(), intervals.end(), by_start);
+
+  for (size_t n = 0; n < intervals.size(); n++) {
+    LiveInterval *cur = intervals[n];
+    expire(cur->start);
+
+    cur->reg = take_free(cur->crosses_call);
+    if (cur->reg != NULL) {
+      add_active(cur);
+      continue;
+    }
+
+    // no register left: spill whichever interval ends last
+    LiveInterval *victim = NULL;
+    for (size_t a = active.size(); a-- > 0; ) {
+      if (may_hold(cur, active[a]->reg)) {
+        victim = active[a];
+        break;
+      }
+    }
+    if (victim != NULL && victim->end > cur->end) {
+      cur->reg = victim->reg;
+      victim->reg = NULL;
+      active.erase(std::find(active.begin(), active.end(), victim));
+      add_active(cur);
+    }
+  }
+
+  allocated = spilled = 0;
+  for (size_t n = 0; n < intervals.size(); n++) {
+    if (intervals[n]->reg != NULL)
+      allocated++;
+    else
+      spilled++;
+  }
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//    Stack slots
+//
+//////////////////////////////////////////////////////////////////
+
+int assign_slots(std::vector<LiveInterval *> &intervals)
+{
+  std::sort(intervals.begin(), intervals.end(), by_start);
+
+  std::vector<LiveInterval *> active;
+  std::vector<int> free_slots;
+  int slots = 0;
+  for (size_t n = 0; n < intervals.size(); n++) {
+    LiveInterval *cur = intervals[n];
+    for (size_t a = 0; a < active.size(); ) {
+      if (active[a]->end < cur->start) {
+        free_slots.push_back(active[a]->slot);
+        active.erase(active.begin() + a);
+      } else {
+        a++;
+      }
+    }
+
+    if (free_slots.empty()) {
+      cur->slot = slots++;
+    } else {
+      cur->slot = free_slots.back();
+      free_slots.pop_back();
+    }
+    active.push_back(cur);
+  }
+  return slots;
+}
@@ -0,0 +1,98 @@
+#ifndef CGEN_REGALLOC_H
+#define CGEN_REGALLOC_H
+
+//
+// Register allocation for the code generator.
+//
+// The instructions of a function's three-address code (cgen_ir.h) are
+// numbered in layout order, and every virtual register gets a live
+// interval from the first to the last position where it is live.  Which
+// values are live across block boundaries comes from the usual backward
+// dataflow over the blocks, so a value carried around a loop covers the
+// whole loop.  An instruction reads its operands and writes its result at
+// the same position.
+//
+// LinearScan then hands out physical registers in the style of Poletto and
+// Sarkar.  Intervals that stay in a register never touch the stack; the
+// rest are spilled to a frame slot.
+//
+
+#include <vector>
+#include "cgen_ir.h"
+
+//
+// live_in[b] and live_out[b] of every block f.blocks[b], as the usual
+// backward dataflow over the blocks.  Globals are left out, they live in
+// memory.
+//
+void liveness(IrFunction &f, std::vector<std::vector<bool> > &live_in,
+              std::vector<std::vector<bool> > &live_out);
+
+struct LiveInterval {
+  int vreg;
+  int start, end;           // first and last position, -1 if never live
+  bool is_float;            // needs an xmm register
+  bool fixed;               // lives in memory we do not own, e.g. a global
+  bool crosses_call;        // a call happens strictly inside the interval
+  const char *reg;          // assigned register, NULL if spilled
+  int slot;                 // frame slot of a spilled interval, -1 if none
+
+  LiveInterval(int v, bool f)
+    : vreg(v), start(-1), end(-1), is_float(f), fixed(false),
+      crosses_call(false), reg(NULL), slot(-1) {}
+  bool used() { return start >= 0; }
+};
+
+class IntervalBuilder {
+private:
+  std::vector<LiveInterval> intervals;      // indexed by vreg
+  std::vector<int> calls;                   // positions of calls, ascending
+
+  void extend(int vreg, int pos);
+
+public:
+  // number f's instructions and compute the intervals, paras are defined
+  // at position 0 before the first block
+  IntervalBuilder(IrFunction &f);
+
+  bool is_leaf() { return calls.empty(); }
+  int vregs() { return intervals.size(); }
+  LiveInterval &interval(int vreg) { return intervals[vreg]; }
+};
+
+//
+// Linear scan over one register class.  Intervals that cross a call may
+// only take one of the callee-saved registers; the others prefer the
+// caller-saved ones so the callee-saved registers stay free.
+//
+class LinearScan {
+private:
+  std::vector<const char *> callee_saved;
+  std::vector<const char *> caller_saved;
+  std::vector<const char *> free_regs;
+  std::vector<LiveInterval *> active;       // sorted by increasing end
+
+  void expire(int start);
+  const char *take_free(bool callee_only);
+  bool may_hold(LiveInterval *i, const char *reg);
+  void add_active(LiveInterval *i);
+
+public:
+  LinearScan(const char **callee, int ncallee, const char **caller, int ncaller);
+
+  // assign registers to intervals; they are sorted by start as a side effect
+  void run(std::vector<LiveInterval *> &intervals);
+
+  int allocated;
+  int spilled;
+};
+
+//
+// Stack slot coloring.  Spilled intervals that do not overlap share a
+// slot, so a frame only needs as many slots as values are live at once.
+// Every slot holds 8 bytes, integers and floats alike.  Returns the number
+// of slots used.
+//
+int assign_slots(std::vector<LiveInterval *> &intervals);
+
+#endif
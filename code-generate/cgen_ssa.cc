@@ -0,0 +1,761 @@
+//**************************************************************
+//
+// SSA form, global value numbering and dead code elimination.
+//
+//**************************************************************
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string.h>
+#include "cgen_ssa.h"
+#include "cgen_loop.h"
+#include "cgen_regalloc.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////////
+//
+//    Dominators
+//
+//////////////////////////////////////////////////////////////////
+
+DominatorTree::DominatorTree(IrFunction &f)
+{
+  int size = 0;
+  for (size_t n = 0; n < f.blocks.size(); n++)
+    size = max(size, f.blocks[n]->id + 1);
+  idoms.assign(size, NULL);
+  order.assign(size, -1);
+  kids.resize(size);
+  frontiers.resize(size);
+
+  // depth first from the entry, every block is reachable after link()
+  vector<IrBlock *> post;
+  vector<pair<IrBlock *, size_t> > stack;
+  vector<bool> seen(size, false);
+  seen[f.blocks[0]->id] = true;
+  stack.push_back(make_pair(f.blocks[0], (size_t) 0));
+  while (!stack.empty()) {
+    IrBlock *b = stack.back().first;
+    size_t next = stack.back().second++;
+    if (next < b->succs.size()) {
+      IrBlock *s = b->succs[next];
+      if (!seen[s->id]) {
+        seen[s->id] = true;
+        stack.push_back(make_pair(s, (size_t) 0));
+      }
+    } else {
+      post.push_back(b);
+      stack.pop_back();
+    }
+  }
+  rpo.assign(post.rbegin(), post.rend());
+  for (size_t n = 0; n < rpo.size(); n++)
+    order[rpo[n]->id] = n;
+
+  IrBlock *entry = rpo[0];
+  idoms[entry->id] = entry;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t n = 1; n < rpo.size(); n++) {
+      IrBlock *b = rpo[n];
+      IrBlock *new_idom = NULL;
+      for (size_t p = 0; p < b->preds.size(); p++) {
+        IrBlock *pred = b->preds[p];
+        if (idoms[pred->id] == NULL)
+          continue;
+        new_idom = new_idom == NULL ? pred : intersect(pred, new_idom);
+      }
+      if (idoms[b->id] != new_idom) {
+        idoms[b->id] = new_idom;
+        changed = true;
+      }
+    }
+  }
+
+  for (size_t n = 1; n < rpo.size(); n++)
+    kids[idoms[rpo[n]->id]->id].push_back(rpo[n]);
+
+  for (size_t n = 0; n < rpo.size(); n++) {
+    IrBlock *b = rpo[n];
+    if (b->preds.size() < 2)
+      continue;
+    for (size_t p = 0; p < b->preds.size(); p++) {
+      for (IrBlock *runner = b->preds[p]; runner != idoms[b->id]; runner = idoms[runner->id]) {
+        vector<IrBlock *> &df = frontiers[runner->id];
+        if (find(df.begin(), df.end(), b) == df.end())
+          df.push_back(b);
+      }
+    }
+  }
+}
+
+IrBlock *DominatorTree::intersect(IrBlock *a, IrBlock *b)
+{
+  while (a != b) {
+    while (order[a->id] > order[b->id])
+      a = idoms[a->id];
+    while (order[b->id] > order[a->id])
+      b = idoms[b->id];
+  }
+  return a;
+}
+
+bool DominatorTree::dominates(IrBlock *a, IrBlock *b)
+{
+  for (; b != NULL; b = idom(b))
+    if (b == a)
+      return true;
+  return false;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//    Into SSA form
+//
+//////////////////////////////////////////////////////////////////
+
+int count_insns(IrFunction &f)
+{
+  int count = 0;
+  for (size_t n = 0; n < f.blocks.size(); n++) {
+    vector<IrInsn> &insns = f.blocks[n]->insns;
+    for (size_t i = 0; i < insns.size(); i++)
+      if (insns[i].op != IR_PHI)
+        count++;
+  }
+  return count;
+}
+
+static bool is_local(IrFunction &f, const Operand &o)
+{
+  return o.kind == Operand::VREG && f.global(o.vreg) == NULL;
+}
+
+static size_t pred_index(IrBlock *b, IrBlock *pred)
+{
+  return find(b->preds.begin(), b->preds.end(), pred) - b->preds.begin();
+}
+
+//
+// Renames along the dominator tree, each name's stack holding its
+// current definition.  An empty stack stands for the value on entry: the
+// para's argument, or whatever an unassigned local holds.
+//
+class Renamer {
+private:
+  IrFunction &f;
+  DominatorTree &dom;
+  vector<bool> &renamed;
+  vector<vector<int> > stacks;
+
+  int top(int v) { return stacks[v].empty() ? v : stacks[v].back(); }
+
+public:
+  Renamer(IrFunction &fn, DominatorTree &d, vector<bool> &r)
+    : f(fn), dom(d), renamed(r), stacks(r.size()) {}
+  void rename(IrBlock *b);
+};
+
+void Renamer::rename(IrBlock *b)
+{
+  vector<int> pushed;
+  vector<Operand *> ops;
+  for (size_t i = 0; i < b->insns.size(); i++) {
+    IrInsn &in = b->insns[i];
+    if (in.op != IR_PHI) {
+      in.operands(ops);
+      for (size_t o = 0; o < ops.size(); o++)
+        if (is_local(f, *ops[o]) && renamed[ops[o]->vreg])
+          ops[o]->vreg = top(ops[o]->vreg);
+    }
+    if (in.dst >= 0 && renamed[in.dst]) {
+      int old = in.dst;
+      int v = f.is_variable(old) ? f.new_variable(f.kind(old)) : f.new_temp(f.kind(old));
+      stacks[old].push_back(v);
+      pushed.push_back(old);
+      b->insns[i].dst = v;
+    }
+  }
+
+  // each phi argument still names the original, and is filled in once
+  for (size_t s = 0; s < b->succs.size(); s++) {
+    IrBlock *succ = b->succs[s];
+    size_t j = pred_index(succ, b);
+    for (size_t i = 0; i < succ->insns.size() && succ->insns[i].op == IR_PHI; i++) {
+      Operand &arg = succ->insns[i].args[j];
+      arg.vreg = top(arg.vreg);
+    }
+  }
+
+  vector<IrBlock *> &kids = dom.children(b);
+  for (size_t k = 0; k < kids.size(); k++)
+    rename(kids[k]);
+
+  for (size_t p = 0; p < pushed.size(); p++)
+    stacks[pushed[p]].pop_back();
+}
+
+void to_ssa(IrFunction &f, SsaStats &stats)
+{
+  DominatorTree dom(f);
+  int vregs = f.vregs();
+  vector<int> defs(vregs, 0);
+  vector<vector<IrBlock *> > def_blocks(vregs);
+  vector<bool> crosses(vregs, false);   // used in a block before any definition there
+  vector<int> defined_in(vregs, -1);
+  vector<Operand *> ops;
+
+  for (size_t n = 0; n < f.blocks.size(); n++) {
+    IrBlock *b = f.blocks[n];
+    for (size_t i = 0; i < b->insns.size(); i++) {
+      IrInsn &in = b->insns[i];
+      in.operands(ops);
+      for (size_t o = 0; o < ops.size(); o++)
+        if (is_local(f, *ops[o]) && defined_in[ops[o]->vreg] != b->id)
+          crosses[ops[o]->vreg] = true;
+      if (in.dst >= 0 && f.global(in.dst) == NULL) {
+        defs[in.dst]++;
+        defined_in[in.dst] = b->id;
+        if (def_blocks[in.dst].empty() || def_blocks[in.dst].back() != b)
+          def_blocks[in.dst].push_back(b);
+      }
+    }
+  }
+
+  // temporaries defined once already have a single definition that
+  // dominates their uses
+  vector<bool> renamed(vregs, false);
+  for (int v = 0; v < vregs; v++)
+    renamed[v] = f.global(v) == NULL && defs[v] > 0 && (f.is_variable(v) || defs[v] > 1);
+
+  vector<int> has_phi(f.blocks.size(), -1);
+  map<IrBlock *, int> position;
+  for (size_t n = 0; n < f.blocks.size(); n++)
+    position[f.blocks[n]] = n;
+  for (int v = 0; v < vregs; v++) {
+    if (!renamed[v] || !crosses[v])
+      continue;
+    vector<IrBlock *> work = def_blocks[v];
+    vector<bool> queued(f.blocks.size(), false);
+    for (size_t w = 0; w < work.size(); w++)
+      queued[position[work[w]]] = true;
+    while (!work.empty()) {
+      IrBlock *b = work.back();
+      work.pop_back();
+      vector<IrBlock *> &df = dom.frontier(b);
+      for (size_t d = 0; d < df.size(); d++) {
+        int at = position[df[d]];
+        if (has_phi[at] == v)
+          continue;
+        has_phi[at] = v;
+        IrInsn phi(IR_PHI, v);
+        phi.args.assign(df[d]->preds.size(), vreg_op(v));
+        df[d]->insns.insert(df[d]->insns.begin(), phi);
+        stats.phis++;
+        if (!queued[at]) {
+          queued[at] = true;
+          work.push_back(df[d]);
+        }
+      }
+    }
+  }
+
+  Renamer r(f, dom, renamed);
+  r.rename(f.blocks[0]);
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//    Global value numbering
+//
+//  An instruction is keyed by its operation and the value numbers of
+//  its operands; a value number is the register that first computed the
+//  value on the dominator tree path.  Reads of globals are not numbered,
+//  a store or a call may change them in between.
+//
+//////////////////////////////////////////////////////////////////
+
+typedef vector<long long> ValueKey;
+
+static bool commutative(IrOp op)
+{
+  return op == IR_ADD || op == IR_MUL || op == IR_AND || op == IR_OR || op == IR_XOR ||
+         op == IR_FADD || op == IR_FMUL;
+}
+
+class ValueNumbering {
+private:
+  IrFunction &f;
+  DominatorTree &dom;
+  vector<int> numbers;                  // indexed by vreg
+  map<ValueKey, int> table;
+
+  bool key(IrInsn &in, ValueKey &k);
+  void push_operand(const Operand &o, ValueKey &k);
+
+public:
+  int removed;
+
+  ValueNumbering(IrFunction &fn, DominatorTree &d);
+  int number(int vreg);
+  Operand value(Operand o);
+  void visit(IrBlock *b);
+};
+
+ValueNumbering::ValueNumbering(IrFunction &fn, DominatorTree &d)
+  : f(fn), dom(d), removed(0)
+{
+  for (int v = 0; v < f.vregs(); v++)
+    numbers.push_back(v);
+}
+
+int ValueNumbering::number(int vreg)
+{
+  while (numbers[vreg] != vreg)
+    vreg = numbers[vreg];
+  return vreg;
+}
+
+Operand ValueNumbering::value(Operand o)
+{
+  if (o.kind == Operand::VREG)
+    o.vreg = number(o.vreg);
+  return o;
+}
+
+void ValueNumbering::push_operand(const Operand &o, ValueKey &k)
+{
+  k.push_back(o.kind);
+  k.push_back(o.kind == Operand::VREG ? o.vreg : o.value);
+}
+
+bool ValueNumbering::key(IrInsn &in, ValueKey &k)
+{
+  switch (in.op) {
+  case IR_MOV:
+  case IR_STRING:
+    // an immediate is cheaper to load again than to keep in a register
+  case IR_CALL:
+  case IR_RET:
+  case IR_JMP:
+  case IR_BR:
+  case IR_PHI:
+    return false;
+  default:
+    break;
+  }
+  if (in.dst < 0 || f.global(in.dst) != NULL)
+    return false;
+  vector<Operand *> ops;
+  in.operands(ops);
+  for (size_t o = 0; o < ops.size(); o++)
+    if (ops[o]->kind == Operand::VREG && f.global(ops[o]->vreg) != NULL)
+      return false;
+
+  long long bits;
+  memcpy(&bits, &in.fvalue, sizeof(bits));
+  k.clear();
+  k.push_back(in.op);
+  k.push_back(f.kind(in.dst));
+  k.push_back(in.rel);
+  k.push_back(in.scale);
+  k.push_back(in.disp);
+  k.push_back(bits);
+  k.push_back((long long) (size_t) in.name);
+  Operand a = in.a, b = in.b;
+  if (commutative(in.op) &&
+      (a.kind < b.kind || (a.kind == b.kind && a.kind == Operand::VREG && a.vreg > b.vreg) ||
+       (a.kind == b.kind && a.kind == Operand::IMM && a.value > b.value)))
+    swap(a, b);
+  push_operand(a, k);
+  push_operand(b, k);
+  return true;
+}
+
+void ValueNumbering::visit(IrBlock *b)
+{
+  vector<ValueKey> added;
+  vector<IrInsn> kept;
+  vector<Operand *> ops;
+  for (size_t i = 0; i < b->insns.size(); i++) {
+    IrInsn &in = b->insns[i];
+    if (in.op == IR_PHI) {
+      // every argument the same value, or the phi itself around a loop;
+      // arguments of blocks not visited yet are still unnumbered
+      int same = -1;
+      bool meaningless = true;
+      for (size_t a = 0; a < in.args.size(); a++) {
+        int v = number(in.args[a].vreg);
+        if (v == in.dst)
+          continue;
+        if (same >= 0 && v != same)
+          meaningless = false;
+        same = v;
+      }
+      if (meaningless && same >= 0) {
+        numbers[in.dst] = same;
+        continue;
+      }
+      kept.push_back(in);
+      continue;
+    }
+
+    in.operands(ops);
+    for (size_t o = 0; o < ops.size(); o++)
+      *ops[o] = value(*ops[o]);
+
+    if (in.op == IR_MOV && is_local(f, in.a) && in.dst >= 0 && f.global(in.dst) == NULL &&
+        f.kind(in.a.vreg) == f.kind(in.dst)) {
+      numbers[in.dst] = in.a.vreg;
+      removed++;
+      continue;
+    }
+    ValueKey k;
+    if (key(in, k)) {
+      map<ValueKey, int>::iterator found = table.find(k);
+      if (found != table.end()) {
+        numbers[in.dst] = found->second;
+        removed++;
+        continue;
+      }
+      table[k] = in.dst;
+      added.push_back(k);
+    }
+    kept.push_back(in);
+  }
+  b->insns.swap(kept);
+
+  for (size_t s = 0; s < b->succs.size(); s++) {
+    IrBlock *succ = b->succs[s];
+    size_t j = pred_index(succ, b);
+    for (size_t i = 0; i < succ->insns.size() && succ->insns[i].op == IR_PHI; i++)
+      succ->insns[i].args[j] = value(succ->insns[i].args[j]);
+  }
+
+  vector<IrBlock *> &kids = dom.children(b);
+  for (size_t k = 0; k < kids.size(); k++)
+    visit(kids[k]);
+
+  for (size_t k = 0; k < added.size(); k++)
+    table.erase(added[k]);
+}
+
+void value_number(IrFunction &f, SsaStats &stats)
+{
+  DominatorTree dom(f);
+  ValueNumbering vn(f, dom);
+  vn.visit(f.blocks[0]);
+
+  // phis numbered away may still be named by arguments of later phis
+  vector<Operand *> ops;
+  for (size_t n = 0; n < f.blocks.size(); n++) {
+    vector<IrInsn> &insns = f.blocks[n]->insns;
+    for (size_t i = 0; i < insns.size(); i++) {
+      insns[i].operands(ops);
+      for (size_t o = 0; o < ops.size(); o++)
+        *ops[o] = vn.value(*ops[o]);
+    }
+  }
+  stats.numbered += vn.removed;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//    Dead code elimination
+//
+//  Optimistic: nothing is live until a call, a return, a branch or a
+//  store to a global needs it, so values that only feed each other
+//  around a loop go too.  Branches are kept, a loop that computes
+//  nothing still runs.
+//
+//////////////////////////////////////////////////////////////////
+
+void eliminate_dead_code(IrFunction &f, SsaStats &stats)
+{
+  vector<IrBlock *> def_block(f.vregs(), NULL);
+  vector<size_t> def_index(f.vregs(), 0);
+  vector<vector<bool> > live(f.blocks.size());
+  vector<pair<size_t, size_t> > work;
+  map<IrBlock *, size_t> position;
+
+  for (size_t n = 0; n < f.blocks.size(); n++) {
+    IrBlock *b = f.blocks[n];
+    position[b] = n;
+    live[n].assign(b->insns.size(), false);
+    for (size_t i = 0; i < b->insns.size(); i++) {
+      IrInsn &in = b->insns[i];
+      if (in.dst >= 0 && f.global(in.dst) == NULL) {
+        def_block[in.dst] = b;
+        def_index[in.dst] = i;
+      }
+      if (in.op == IR_CALL || in.is_terminator() || (in.dst >= 0 && f.global(in.dst) != NULL)) {
+        live[n][i] = true;
+        work.push_back(make_pair(n, i));
+      }
+    }
+  }
+
+  vector<Operand *> ops;
+  while (!work.empty()) {
+    IrInsn &in = f.blocks[work.back().first]->insns[work.back().second];
+    work.pop_back();
+    in.operands(ops);
+    for (size_t o = 0; o < ops.size(); o++) {
+      if (!is_local(f, *ops[o]) || def_block[ops[o]->vreg] == NULL)
+        continue;
+      size_t n = position[def_block[ops[o]->vreg]];
+      size_t i = def_index[ops[o]->vreg];
+      if (!live[n][i]) {
+        live[n][i] = true;
+        work.push_back(make_pair(n, i));
+      }
+    }
+  }
+
+  for (size_t n = 0; n < f.blocks.size(); n++) {
+    vector<IrInsn> kept;
+    vector<IrInsn> &insns = f.blocks[n]->insns;
+    for (size_t i = 0; i < insns.size(); i++) {
+      if (live[n][i])
+        kept.push_back(insns[i]);
+      else if (insns[i].op != IR_PHI)
+        stats.dead++;
+    }
+    insns.swap(kept);
+  }
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//    Out of SSA form
+//
+//  Each phi x = phi(a1, ..., an) gets a fresh register t: every
+//  predecessor i ends in t = ai and the phi becomes x = t, which keeps
+//  the phis of a block parallel.  Copies on a critical edge go to a new
+//  block on that edge.  Coalescing then merges the registers of every
+//  copy whose live ranges do not interfere, so most copies vanish again.
+//
+//////////////////////////////////////////////////////////////////
+
+static void place_copies(IrFunction &f, IrBlock *pred, IrBlock *succ, vector<IrInsn> &copies)
+{
+  if (pred->succs.size() > 1) {
+    // a critical edge, pred ends in a branch
+    IrBlock *edge = f.new_block();
+    IrInsn &br = pred->insns.back();
+    for (int t = 0; t < 2; t++)
+      if (br.target[t] == succ)
+        br.target[t] = edge;
+    edge->insns = copies;
+    edge->insns.push_back(IrInsn(IR_JMP, -1));
+    edge->insns.back().target[0] = succ;
+    vector<IrBlock *>::iterator at = find(f.blocks.begin(), f.blocks.end(), pred);
+    f.blocks.insert(at + 1, edge);
+    replace(pred->succs.begin(), pred->succs.end(), succ, edge);
+    return;
+  }
+  vector<IrInsn> &insns = pred->insns;
+  insns.insert(pred->terminated() ? insns.end() - 1 : insns.end(), copies.begin(), copies.end());
+}
+
+static bool two_address(IrOp op)
+{
+  return (op >= IR_ADD && op <= IR_FNEG && op != IR_DIV && op != IR_MOD);
+}
+
+static int root(vector<int> &merged, int v)
+{
+  while (merged[v] != v)
+    v = merged[v];
+  return v;
+}
+
+// give dst and o one register if they never hold different values at once
+static bool join(IrFunction &f, vector<int> &merged, vector<set<int> > &interferes,
+                 vector<bool> &is_para, int dst, const Operand &o)
+{
+  if (!is_local(f, o))
+    return false;
+  int keep = root(merged, o.vreg), gone = root(merged, dst);
+  if (keep == gone)
+    return true;
+  if (f.kind(keep) != f.kind(gone) || interferes[keep].count(gone))
+    return false;
+  // a para keeps its register, the arguments arrive there
+  if (is_para[gone])
+    swap(keep, gone);
+  merged[gone] = keep;
+  for (set<int>::iterator v = interferes[gone].begin(); v != interferes[gone].end(); ++v) {
+    interferes[*v].erase(gone);
+    interferes[*v].insert(keep);
+    interferes[keep].insert(*v);
+  }
+  interferes[gone].clear();
+  return true;
+}
+
+static void coalesce(IrFunction &f)
+{
+  int vregs = f.vregs();
+  vector<vector<bool> > live_in, live_out;
+  liveness(f, live_in, live_out);
+
+  vector<set<int> > interferes(vregs);
+  vector<Operand *> ops;
+  for (size_t n = 0; n < f.blocks.size(); n++) {
+    vector<bool> live = live_out[n];
+    vector<IrInsn> &insns = f.blocks[n]->insns;
+    for (size_t i = insns.size(); i-- > 0; ) {
+      IrInsn &in = insns[i];
+      if (in.dst >= 0 && f.global(in.dst) == NULL) {
+        // a copy does not make its source and destination interfere
+        int source = in.op == IR_MOV && is_local(f, in.a) ? in.a.vreg : -1;
+        for (int v = 0; v < vregs; v++) {
+          if (live[v] && v != in.dst && v != source) {
+            interferes[in.dst].insert(v);
+            interferes[v].insert(in.dst);
+          }
+        }
+        live[in.dst] = false;
+      }
+      in.operands(ops);
+      for (size_t o = 0; o < ops.size(); o++)
+        if (is_local(f, *ops[o]))
+          live[ops[o]->vreg] = true;
+    }
+  }
+
+  // the paras and whatever else is live on entry all hold values at once
+  vector<int> entry(f.params);
+  for (int v = 0; v < vregs; v++)
+    if (live_in[0][v] && find(entry.begin(), entry.end(), v) == entry.end())
+      entry.push_back(v);
+  for (size_t i = 0; i < entry.size(); i++)
+    for (size_t j = i + 1; j < entry.size(); j++) {
+      interferes[entry[i]].insert(entry[j]);
+      interferes[entry[j]].insert(entry[i]);
+    }
+
+  vector<int> merged(vregs);
+  for (int v = 0; v < vregs; v++)
+    merged[v] = v;
+  vector<bool> is_para(vregs, false);
+  for (size_t p = 0; p < f.params.size(); p++)
+    is_para[f.params[p]] = true;
+
+  // copies first, then the result of a two-address operation with an
+  // operand that dies there, x86 overwrites the first operand anyway
+  for (int pass = 0; pass < 2; pass++) {
+    for (size_t n = 0; n < f.blocks.size(); n++) {
+      vector<IrInsn> &insns = f.blocks[n]->insns;
+      for (size_t i = 0; i < insns.size(); i++) {
+        IrInsn &in = insns[i];
+        if (in.dst < 0 || f.global(in.dst) != NULL)
+          continue;
+        if (pass == 0 && in.op == IR_MOV) {
+          join(f, merged, interferes, is_para, in.dst, in.a);
+        } else if (pass == 1 && two_address(in.op)) {
+          if (!join(f, merged, interferes, is_para, in.dst, in.a) && commutative(in.op))
+            join(f, merged, interferes, is_para, in.dst, in.b);
+        }
+      }
+    }
+  }
+
+  for (size_t n = 0; n < f.blocks.size(); n++) {
+    vector<IrInsn> kept;
+    vector<IrInsn> &insns = f.blocks[n]->insns;
+    for (size_t i = 0; i < insns.size(); i++) {
+      IrInsn &in = insns[i];
+      in.operands(ops);
+      for (size_t o = 0; o < ops.size(); o++)
+        if (is_local(f, *ops[o]))
+          ops[o]->vreg = root(merged, ops[o]->vreg);
+      if (in.dst >= 0)
+        in.dst = root(merged, in.dst);
+      if (in.op == IR_MOV && in.a.kind == Operand::VREG && in.a.vreg == in.dst)
+        continue;
+      kept.push_back(in);
+    }
+    insns.swap(kept);
+  }
+}
+
+// blocks left holding nothing but a jump are bypassed and dropped
+static void skip_jumps(IrFunction &f)
+{
+  for (size_t n = 1; n < f.blocks.size(); n++) {
+    IrBlock *b = f.blocks[n];
+    if (b->insns.size() != 1 || b->insns[0].op != IR_JMP || b->insns[0].target[0] == b ||
+        !f.blocks[n - 1]->terminated())
+      continue;
+    IrBlock *to = b->insns[0].target[0];
+    for (size_t m = 0; m < f.blocks.size(); m++) {
+      if (!f.blocks[m]->terminated())
+        continue;
+      IrInsn &last = f.blocks[m]->insns.back();
+      for (int t = 0; t < 2; t++)
+        if (last.target[t] == b)
+          last.target[t] = to;
+      if (last.op == IR_BR && last.target[0] == last.target[1]) {
+        IrInsn jump(IR_JMP, -1);
+        jump.target[0] = to;
+        last = jump;
+      }
+    }
+  }
+  f.link();
+}
+
+void from_ssa(IrFunction &f, SsaStats &stats)
+{
+  vector<IrBlock *> joins;
+  for (size_t n = 0; n < f.blocks.size(); n++)
+    if (!f.blocks[n]->insns.empty() && f.blocks[n]->insns[0].op == IR_PHI)
+      joins.push_back(f.blocks[n]);
+
+  for (size_t j = 0; j < joins.size(); j++) {
+    IrBlock *b = joins[j];
+    vector<vector<IrInsn> > copies(b->preds.size());
+    for (size_t i = 0; i < b->insns.size() && b->insns[i].op == IR_PHI; i++) {
+      IrInsn &phi = b->insns[i];
+      int t = f.new_temp(f.kind(phi.dst));
+      for (size_t p = 0; p < phi.args.size(); p++) {
+        copies[p].push_back(IrInsn(IR_MOV, t));
+        copies[p].back().a = phi.args[p];
+      }
+      phi.op = IR_MOV;
+      phi.args.clear();
+      phi.a = vreg_op(t);
+    }
+    vector<IrBlock *> preds = b->preds;
+    for (size_t p = 0; p < preds.size(); p++)
+      place_copies(f, preds[p], b, copies[p]);
+  }
+  f.link();
+
+  coalesce(f);
+  skip_jumps(f);
+  stats.after = count_insns(f);
+}
+
+// the most instructions of a loop test copied to the bottom of the loop
+static const size_t MAX_ROTATED = 8;
+// the most instructions the copies of one unrolled loop come to
+static const size_t MAX_UNROLLED = 64;
+
+void optimize_ssa(IrFunction &f, const set<Symbol> &pure, int unroll_factor,
+                  int unroll_trips, SsaStats &stats)
+{
+  stats.before = count_insns(f);
+  stats.unrolled += unroll_loops(f, unroll_factor, unroll_trips, MAX_UNROLLED);
+  to_ssa(f, stats);
+  value_number(f, stats);
+  stats.hoisted += hoist_invariants(f, pure);
+  eliminate_dead_code(f, stats);
+  from_ssa(f, stats);
+  stats.rotated += rotate_loops(f, MAX_ROTATED);
+}
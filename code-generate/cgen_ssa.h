@@ -0,0 +1,86 @@
+#ifndef CGEN_SSA_H
+#define CGEN_SSA_H
+
+//
+// The SSA mid-end of the code generator, run under -O.
+//
+// Counted loops are unrolled first (cgen_loop.h), while every variable
+// is still one virtual register.  Locals and paras are already virtual
+// registers after lowering, so promoting them needs no loads or stores
+// to remove: to_ssa() renames every local, para and temporary assigned
+// more than once until each virtual register has exactly one definition,
+// placing IR_PHIs at the iterated dominance frontiers of the assignments
+// (Cytron et al.).  Only names live across a block boundary get phis.
+// Globals keep their fixed registers, they live in memory.
+//
+// On SSA form value_number() walks the dominator tree replacing an
+// instruction by an equal one that dominates it and propagating copies
+// (Briggs, Cooper and Simpson), invariants leave their loops
+// (cgen_loop.h), and eliminate_dead_code() marks what calls, returns,
+// branches and stores to globals need and drops the rest.
+// from_ssa() turns each phi into copies at the end of the predecessors,
+// splitting critical edges, and coalesces the copies whose registers do
+// not interfere so a variable ends up in one register again.
+//
+
+#include <set>
+#include <vector>
+#include "cgen_ir.h"
+
+//
+// Dominators of the blocks of a linked IrFunction, by the iterative
+// algorithm of Cooper, Harvey and Kennedy.  Blocks are looked up by id;
+// blocks created afterwards are unknown.
+//
+class DominatorTree {
+private:
+  std::vector<IrBlock *> idoms;                 // indexed by id
+  std::vector<int> order;                       // reverse postorder number
+  std::vector<std::vector<IrBlock *> > kids;
+  std::vector<std::vector<IrBlock *> > frontiers;
+  std::vector<IrBlock *> rpo;
+
+  IrBlock *intersect(IrBlock *a, IrBlock *b);
+
+public:
+  DominatorTree(IrFunction &f);
+
+  // NULL for the entry
+  IrBlock *idom(IrBlock *b) { return b == rpo[0] ? NULL : idoms[b->id]; }
+  bool dominates(IrBlock *a, IrBlock *b);
+  // the blocks b immediately dominates, in reverse postorder
+  std::vector<IrBlock *> &children(IrBlock *b) { return kids[b->id]; }
+  std::vector<IrBlock *> &frontier(IrBlock *b) { return frontiers[b->id]; }
+  std::vector<IrBlock *> &reverse_postorder() { return rpo; }
+};
+
+// instruction counts of one function, reported under -c
+struct SsaStats {
+  int before;               // after lowering
+  int phis;                 // placed by to_ssa
+  int numbered;             // replaced by value numbering
+  int hoisted;              // moved out of loops
+  int dead;                 // removed as dead
+  int after;                // after leaving SSA form
+  int rotated;              // loops tested at the bottom
+  int unrolled;             // loops unrolled before entering SSA form
+  SsaStats() : before(0), phis(0), numbered(0), hoisted(0), dead(0), after(0),
+               rotated(0), unrolled(0) {}
+};
+
+// the instructions of f, phis do not count
+int count_insns(IrFunction &f);
+
+void to_ssa(IrFunction &f, SsaStats &stats);
+void value_number(IrFunction &f, SsaStats &stats);
+void eliminate_dead_code(IrFunction &f, SsaStats &stats);
+void from_ssa(IrFunction &f, SsaStats &stats);
+
+// all of the above in order, unrolling loops first by unroll_factor, or
+// completely if they run at most unroll_trips times, hoisting loop
+// invariants after value numbering and rotating loops at the end; calls
+// to the functions in pure may be hoisted
+void optimize_ssa(IrFunction &f, const std::set<Symbol> &pure, int unroll_factor,
+                  int unroll_trips, SsaStats &stats);
+
+#endif
@@ -10,7 +10,7 @@ void emit_string_constant(ostream& str, char* s)
   str << "\"";
 
   print_escaped_string(str, s);
-  str << "\"" << endl;
+  str << "\"" << '\n';
 }
 
 
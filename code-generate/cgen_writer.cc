@@ -0,0 +1,74 @@
+//**************************************************************
+//
+// Buffered writer for the generated assembly.
+//
+//**************************************************************
+
+#include <string.h>
+#include "cgen_writer.h"
+
+using namespace std;
+
+AsmWriter::AsmWriter(streambuf *sink, size_t size) : sink(sink), size(size)
+{
+  buf = new char[size];
+  setp(buf, buf + size);
+}
+
+AsmWriter::~AsmWriter()
+{
+  flush();
+  delete [] buf;
+}
+
+void AsmWriter::flush()
+{
+  if (pptr() > pbase())
+    sink->sputn(pbase(), pptr() - pbase());
+  setp(buf, buf + size);
+}
+
+AsmWriter::int_type AsmWriter::overflow(int_type c)
+{
+  flush();
+  if (c != traits_type::eof()) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+streamsize AsmWriter::xsputn(const char *s, streamsize n)
+{
+  if (n > epptr() - pptr()) {
+    flush();
+    // larger than the whole buffer, nothing to gain from copying it
+    if ((size_t) n >= size)
+      return sink->sputn(s, n);
+  }
+  memcpy(pptr(), s, n);
+  pbump(n);
+  return n;
+}
+
+int AsmWriter::sync()
+{
+  flush();
+  return sink->pubsync();
+}
+
+ostream &operator<<(ostream &s, decimal d)
+{
+  char digits[24];
+  char *end = digits + sizeof(digits);
+  char *p = end;
+  unsigned long long v = d.value < 0 ? -(unsigned long long) d.value : d.value;
+  do {
+    *--p = '0' + v % 10;
+    v /= 10;
+  } while (v != 0);
+  if (d.value < 0)
+    *--p = '-';
+  s.rdbuf()->sputn(p, end - p);
+  return s;
+}
@@ -0,0 +1,45 @@
+#ifndef CGEN_WRITER_H
+#define CGEN_WRITER_H
+
+//
+// Output buffer for the generated assembly.
+//
+// The code generator writes through an ostream whose streambuf is an
+// AsmWriter.  Lines end in '\n' rather than endl, so nothing is handed to
+// the output file until the buffer fills up or flush() is called at the
+// end of the compile.  The buffer is allocated once and reused.
+//
+
+#include <iostream>
+
+class AsmWriter : public std::streambuf {
+private:
+  std::streambuf *sink;
+  char *buf;
+  size_t size;
+
+protected:
+  int_type overflow(int_type c);
+  std::streamsize xsputn(const char *s, std::streamsize n);
+  int sync();
+
+public:
+  AsmWriter(std::streambuf *sink, size_t size = 1 << 20);
+  ~AsmWriter();
+
+  // hand everything buffered so far to the sink
+  void flush();
+};
+
+//
+// A number in decimal, formatted by hand rather than through the locale
+// machinery behind operator<<(int).  The output is the same.
+//
+struct decimal {
+  long long value;
+  explicit decimal(long long v) : value(v) {}
+};
+
+std::ostream &operator<<(std::ostream &s, decimal d);
+
+#endif
@@ -29,6 +29,7 @@
 #define FLOATTAG                "\t.long\t"
 #define BOOLTAG                 "\t.long\t"
 #define ALIGN                   "\t.align\t"
+#define P2ALIGN                 "\t.p2align\t"
 
 // comma
 #define COMMA                   ", "
@@ -74,11 +75,20 @@
 #define XMM5    "%xmm5"     // float register
 #define XMM6    "%xmm6"     // float register
 #define XMM7    "%xmm7"     // float register
+#define XMM8    "%xmm8"     // float register
+#define XMM9    "%xmm9"     // float register
+#define XMM10   "%xmm10"    // float register
+#define XMM11   "%xmm11"    // float register
+#define XMM12   "%xmm12"    // float register
+#define XMM13   "%xmm13"    // float register
+#define XMM14   "%xmm14"    // float register
+#define XMM15   "%xmm15"    // float register
 
 //
 // Opcodes
 // int
 #define MOV     "\tmovq\t"  
+#define LEA     "\tleaq\t"
 
 #define CALL    "\tcall\t"
 #define RET     "\tret\t"
@@ -107,6 +117,13 @@
 #define TEST    "\ttestq\t"
 #define JZ      "\tjz\t"
 #define JNZ     "\tjnz\t"
+#define SETL    "\tsetl\t"
+#define SETLE   "\tsetle\t"
+#define SETE    "\tsete\t"
+#define SETNE   "\tsetne\t"
+#define SETGE   "\tsetge\t"
+#define SETG    "\tsetg\t"
+#define MOVZBL  "\tmovzbl\t"
 // float
 #define MOVSD   "\tmovsd\t" 
 
@@ -133,4 +150,5 @@
 
 // printf
 #define MOVL     "\tmovl\t" 
-#define EAX     "%eax"      // 32 bit general purpose register
\ No newline at end of file
+#define EAX     "%eax"      // 32 bit general purpose register
+#define AL      "%al"       // low byte of %rax, set by setcc
\ No newline at end of file
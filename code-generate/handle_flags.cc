@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 #include "seal-io.h"
 #include <unistd.h>
 #include "cgen_gc.h"
@@ -30,6 +31,8 @@ extern int seal_yydebug;        // for the parser
        bool disable_reg_alloc;  // Don't do register allocation
 
        int cgen_optimize;       // optimize switch for code generator 
+       int cgen_unroll_factor;  // loop bodies per test under -O, 1 for none
+       int cgen_unroll_trips;   // under -O loops running at most this often are unrolled completely
        char *out_filename;      // file name for generated code
        Memmgr cgen_Memmgr = GC_NOGC;      // enable/disable garbage collection
        Memmgr_Test cgen_Memmgr_Test = GC_NORMAL;  // normal/test GC
@@ -39,6 +42,17 @@ extern int seal_yydebug;        // for the parser
 extern int optind, opterr;
 extern char *optarg;
 
+// Reads a whole decimal count of at least min from arg into *count.
+// Returns 0, leaving *count alone, if arg is anything else.
+static int read_count(const char *arg, long min, int *count) {
+  char *end;
+  long value = strtol(arg, &end, 10);
+  if (end == arg || *end != '\0' || value < min || value > INT_MAX)
+    return 0;
+  *count = (int) value;
+  return 1;
+}
+
 void handle_flags(int argc, char *argv[]) {
   int c;
   int unknownopt = 0;
@@ -50,10 +64,12 @@ void handle_flags(int argc, char *argv[]) {
   semant_debug = 0;
   cgen_debug = 0;
   cgen_optimize = 0;
+  cgen_unroll_factor = 4;
+  cgen_unroll_trips = 8;
   disable_reg_alloc = 0;
   
 
-  while ((c = getopt(argc, argv, "lpscvrOo:gtT")) != -1) {
+  while ((c = getopt(argc, argv, "lpscvrOo:gtTu:U:")) != -1) {
     switch (c) {
 #ifdef DEBUG
     case 'l':
@@ -99,6 +115,14 @@ void handle_flags(int argc, char *argv[]) {
     case 'O':  // enable optimization
       cgen_optimize = 1;
       break;
+    case 'u':  // unroll loops by this factor under -O
+      if (!read_count(optarg, 1, &cgen_unroll_factor))
+        unknownopt = 1;
+      break;
+    case 'U':  // unroll loops completely up to this many trips under -O
+      if (!read_count(optarg, 0, &cgen_unroll_trips))
+        unknownopt = 1;
+      break;
     case '?':
       unknownopt = 1;
       break;
@@ -111,9 +135,9 @@ void handle_flags(int argc, char *argv[]) {
   if (unknownopt) {
       cerr << "usage: " << argv[0] << 
 #ifdef DEBUG
-	  " [-lvpscOgtTr -o outname] [input-files]\n";
+	  " [-lvpscOgtTr -u factor -U trips -o outname] [input-files]\n";
 #else
-      " [-OgtT -o outname] [input-files]\n";
+      " [-OgtT -u factor -U trips -o outname] [input-files]\n";
 #endif
       exit(1);
   }
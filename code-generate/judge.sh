@@ -17,4 +17,37 @@ for filename in *.seal; do
 done
 
 rm -f tempfile tempfile2
-cd ..
\ No newline at end of file
+
+# the optimizations must not change what a program prints
+cd ../test-optimize
+for filename in *.seal; do
+    for flags in "" -O; do
+        echo "--------Test using" $filename $flags "--------"
+        ../cgen $filename $flags -o tempfile.s
+        gcc tempfile.s -o tempfile -no-pie
+        ./tempfile > tempfile.out
+        diff tempfile.out ../test-answer/$filename.out > /dev/null
+        if [ $? -eq 0 ] ; then
+            echo passed
+        else
+            echo NOT passed
+        fi
+    done
+done
+rm -f tempfile tempfile.s tempfile.out
+cd ..
+
+# programs with semantic errors, compared on what cgen reports for them
+cd test-error
+for filename in *.seal; do
+    echo "--------Test using" $filename "--------"
+    ../cgen $filename -o tempfile.s 2> tempfile.err
+    diff tempfile.err ../test-answer/$filename.err > /dev/null
+    if [ $? -eq 0 ] ; then
+        echo passed
+    else
+        echo NOT passed
+    fi
+done
+rm -f tempfile.s tempfile.err
+cd ..
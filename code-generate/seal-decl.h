@@ -26,6 +26,7 @@ protected:
    Symbol name;
    Symbol type;
 public:
+   Binding binding;                  // set by semant
    Variable_class(Symbol a1, Symbol a2) {
       name = a1;
       type = a2;
@@ -48,6 +49,7 @@ public:
    }
    Symbol getName() { return variable->getName(); }
    Symbol getType() { return variable->getType(); }
+   Variable getVariable() { return variable; }
 
    Decl copy_Decl();
    void dump(ostream& stream, int n);
@@ -83,6 +85,7 @@ public:
    bool isCallDecl(){return true;}
    void check();
    void code(ostream&);
+   void lower(IrFunction&);
 };
 
 typedef class Decl_class *Decl;
@@ -16,22 +16,42 @@ typedef class Call_class *Call;
 class Expr_class : public Stmt_class {
 public:     
    Symbol type;                      
+   TypeKind kind;                    // type as an enum, kept in step by setType
+   Operand operand;                  // where lower() left the value
    Stmt copy_Stmt() { return copy_Expr(); }   
    Symbol getType() { return type; }           
-   Expr setType(Symbol s) { type = s; return this; }           
-   Expr_class() { type = (Symbol) NULL; }
+   TypeKind getKind() { return kind; }
+   Expr setType(Symbol s) { type = s; kind = type_kind(s); return this; }           
+   Expr_class() { type = (Symbol) NULL; kind = TYPE_NONE; }
    Expr_class(Symbol a1) {
-        type = a1;
+        setType(a1);
    }
    void check(Symbol s) {checkType();}
+   bool isReturn(){return false;}
+   bool isBreak(){return false;}
+   bool isContinue(){return false;}
    void dump_type(ostream&, int);
    
    virtual void dump_with_types(ostream&,int) = 0; 
 	virtual void dump(ostream&,int) = 0;
    virtual Expr copy_Expr() = 0;
    virtual Symbol checkType() = 0;
+   // constant folding under -O, returns the expression to use in place of this one
+   virtual Expr fold() = 0;
+   // the value of a constant, false if this is not one
+   virtual bool int_value(long long &) { return false; }
+   virtual bool float_value(double &) { return false; }
+   virtual bool bool_value(bool &) { return false; }
+   // evaluating it has no effect, so folding may drop it
+   virtual bool is_pure() { return false; }
+   // the Int sum this computes as an address, see cgen_ir.h
+   virtual bool address(Address &) { return false; }
+   // an Int product index*scale that leaq can scale by
+   virtual bool scaled(Expr &, int &) { return false; }
    virtual bool is_empty_Expr() = 0;
-   virtual void code(ostream&) = 0;
+   virtual void lower(IrBuilder&) = 0;
+   // as a condition: go to if_true when the value is true, else to if_false
+   virtual void lower_branch(IrBuilder&, IrBlock *if_true, IrBlock *if_false);
 };
 
 class Call_class : public Expr_class {
@@ -51,7 +71,8 @@ public:
    void dump_type(ostream& , int );
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
 };
 
 
@@ -68,7 +89,8 @@ public:
    void dump_type(ostream& , int );
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
 };
 
 // define constructor - expr
@@ -77,6 +99,7 @@ protected:
    Symbol lvalue;
    Expr value;
 public:
+   Binding binding;                  // the variable assigned, set by semant
    Assign_class(Symbol a1, Expr a2)  {
       lvalue = a1;
       value = a2;
@@ -86,7 +109,8 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
 };
 
 // define constructor - add
@@ -104,7 +128,9 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
+   bool address(Address &);
 };
 
 // define constructor - minus
@@ -122,7 +148,9 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
+   bool address(Address &);
 };
 
 // define constructor - multi
@@ -140,7 +168,9 @@ public:
    void dump_with_types(ostream&,int);
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
+   bool scaled(Expr &, int &);
 };
 
 // define constructor - divide
@@ -158,7 +188,8 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
 };
 
 // define constructor - mod
@@ -176,7 +207,8 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
 };
 
 // define constructor - -
@@ -192,7 +224,8 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
 };
 
 // define constructor - <
@@ -210,7 +243,9 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
+   void lower_branch(IrBuilder&, IrBlock *, IrBlock *);
 };
 
 // define constructor - <=
@@ -228,7 +263,9 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
+   void lower_branch(IrBuilder&, IrBlock *, IrBlock *);
 };
 
 // define constructor - ==
@@ -246,7 +283,9 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
+   void lower_branch(IrBuilder&, IrBlock *, IrBlock *);
 };
 
 // define constructor - !=
@@ -264,7 +303,9 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
+   void lower_branch(IrBuilder&, IrBlock *, IrBlock *);
 };
 
 // define constructor - >=
@@ -282,7 +323,9 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
+   void lower_branch(IrBuilder&, IrBlock *, IrBlock *);
 };
 
 // define constructor - >
@@ -300,7 +343,9 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
+   void lower_branch(IrBuilder&, IrBlock *, IrBlock *);
 };
 
 // define constructor - and &&
@@ -318,7 +363,9 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
+   void lower_branch(IrBuilder&, IrBlock *, IrBlock *);
 };
 
 // define constructor - or ||
@@ -336,7 +383,9 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
+   void lower_branch(IrBuilder&, IrBlock *, IrBlock *);
 };
 
 // define constructor - xor ^
@@ -354,7 +403,8 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
 };
 
 // define constructor - not !
@@ -370,7 +420,9 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
+   void lower_branch(IrBuilder&, IrBlock *, IrBlock *);
 };
 
 // define constructor - bitnot ~
@@ -386,7 +438,8 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
 };
 
 class Bitand_class : public Expr_class {
@@ -403,7 +456,8 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
 };
 
 class Bitor_class : public Expr_class {
@@ -420,7 +474,8 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
 };
 
 // define constructconst_int - const_int
@@ -436,7 +491,10 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   bool int_value(long long &v) { v = ((IntEntryP) value)->get_value(); return true; }
+   bool is_pure() { return true; }
+   void lower(IrBuilder&);
 };
 
 // define constructconst_string - const_string
@@ -452,7 +510,9 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   bool is_pure() { return true; }
+   void lower(IrBuilder&);
 };
 
 // define constructconst_float - const_float
@@ -468,7 +528,10 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   bool float_value(double &v) { v = ((FloatEntryP) value)->get_value(); return true; }
+   bool is_pure() { return true; }
+   void lower(IrBuilder&);
 };
 
 // define constructconst_bool - const_bool
@@ -484,13 +547,18 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   bool bool_value(bool &v) { v = value; return true; }
+   bool is_pure() { return true; }
+   void lower(IrBuilder&);
+   void lower_branch(IrBuilder&, IrBlock *, IrBlock *);
 };
 
 class Object_class : public Expr_class {
 protected:
    Symbol var;
 public:
+   Binding binding;                  // the variable read, set by semant
    Object_class(Symbol a1) {
       var = a1;
    }
@@ -500,7 +568,9 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   bool is_pure() { return true; }
+   void lower(IrBuilder&);
 };
 
 // define constructor - no_expr
@@ -514,7 +584,8 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return true;}
    Symbol checkType();
-   void code(ostream&);
+   Expr fold();
+   void lower(IrBuilder&);
 };
 
 
@@ -31,7 +31,11 @@ public:
 	virtual void dump_with_types(ostream&,int) = 0; 
 	virtual void dump(ostream&,int) = 0;
 	virtual void check(Symbol) = 0;
-	virtual void code(ostream&) = 0;
+	virtual Stmt fold() = 0;
+	virtual bool isReturn() = 0;
+	virtual bool isBreak() = 0;
+	virtual bool isContinue() = 0;
+	virtual void lower(IrBuilder&) = 0;
 };
 
 class StmtBlock_class : public Stmt_class {
@@ -51,7 +55,35 @@ public:
 	void dump(ostream& , int );
 	void dump_with_types(ostream&,int);
 	void check(Symbol);
-	void code(ostream&);
+	Stmt fold();
+	bool isReturn() {
+		bool flag = false;
+		for (int i=stmts->first(); stmts->more(i); i=stmts->next(i)) {
+			if (stmts->nth(i)->isReturn() == true) {
+				flag = true;
+			}
+		}
+		return flag;
+	}
+	bool isBreak() {
+		bool flag = false;
+		for (int i=stmts->first(); stmts->more(i); i=stmts->next(i)) {
+			if (stmts->nth(i)->isBreak() == true) {
+				flag = true;
+			}
+		}
+		return flag;
+	}
+	bool isContinue() {
+		bool flag = false;
+		for (int i=stmts->first(); stmts->more(i); i=stmts->next(i)) {
+			if (stmts->nth(i)->isContinue() == true) {
+				flag = true;
+			}
+		}
+		return flag;
+	}
+	void lower(IrBuilder&);
 };
 
 class IfStmt_class : public Stmt_class {
@@ -72,7 +104,11 @@ public:
 	void dump(ostream& stream, int n);
 	void dump_with_types(ostream&,int);
 	void check(Symbol);
-	void code(ostream&);
+	Stmt fold();
+	bool isReturn(){return false;}
+	bool isBreak(){return false;}
+	bool isContinue(){return false;}
+	void lower(IrBuilder&);
 };
 
 
@@ -93,7 +129,11 @@ public:
 	void dump(ostream& stream, int n);
 	void dump_with_types(ostream&,int);
 	void check(Symbol);
-	void code(ostream&);
+	Stmt fold();
+	bool isReturn(){return false;}
+	bool isBreak(){return false;}
+	bool isContinue(){return false;}
+	void lower(IrBuilder&);
 };
 
 class ForStmt_class : public Stmt_class {
@@ -115,7 +155,11 @@ public:
 	void dump(ostream& stream, int n);
 	void dump_with_types(ostream&,int);
 	void check(Symbol);
-	void code(ostream&);
+	Stmt fold();
+	bool isReturn(){return false;}
+	bool isBreak(){return false;}
+	bool isContinue(){return false;}
+	void lower(IrBuilder&);
 };
 
 
@@ -132,7 +176,11 @@ public:
     void dump_with_types(ostream&,int);
     void dump(ostream& stream, int n);
 	void check(Symbol);
-	void code(ostream&);
+	Stmt fold();
+	bool isReturn(){return true;}
+	bool isBreak(){return false;}
+	bool isContinue(){return false;}
+	void lower(IrBuilder&);
 };
 
 class ContinueStmt_class : public Stmt_class {
@@ -142,7 +190,11 @@ public:
     void dump_with_types(ostream&,int);
     void dump(ostream& stream, int n);
 	void check(Symbol);
-	void code(ostream&);
+	Stmt fold();
+	bool isReturn(){return false;}
+	bool isBreak(){return false;}
+	bool isContinue(){return true;}
+	void lower(IrBuilder&);
 };
 
 
@@ -153,7 +205,11 @@ public:
     void dump_with_types(ostream&,int);
     void dump(ostream& stream, int n);
 	void check(Symbol);
-	void code(ostream&);
+	Stmt fold();
+	bool isReturn(){return false;}
+	bool isBreak(){return true;}
+	bool isContinue(){return false;}
+	void lower(IrBuilder&);
 };
 
 typedef class Program_class *Program;
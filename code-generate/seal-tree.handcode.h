@@ -20,6 +20,42 @@ void dump_Symbol(ostream& stream, int padding, Symbol b);
 void assert_Symbol(Symbol b);
 Symbol copy_Symbol(Symbol b);
 
+//
+// The basic types as a small enum.  setType caches one on every
+// expression, so type dispatch is a switch rather than comparisons
+// against the type Symbols.  type_kind is defined in semant.cc next to
+// the Symbols it maps.
+//
+enum TypeKind { TYPE_NONE, TYPE_INT, TYPE_FLOAT, TYPE_BOOL, TYPE_STRING, TYPE_VOID };
+TypeKind type_kind(Symbol type);
+
+//
+// Where a variable name resolves to.  Semant fills one in for every
+// variable and every use of one, so the code generator never looks a
+// name up again.  index is the position of a para, the slot of a local
+// within its function, or the number of a global.
+//
+struct Binding {
+  enum Kind { UNBOUND, PARA, LOCAL, STATIC };
+  Kind kind;
+  int index;
+  Symbol name;
+  Binding() : kind(UNBOUND), index(-1), name(NULL) {}
+  Binding(Kind k, int i, Symbol n) : kind(k), index(i), name(n) {}
+};
+
+//
+// Where the code generator's three-address code (cgen_ir.h) finds a
+// value: in a virtual register or as an immediate.
+//
+struct Operand {
+  enum Kind { NONE, VREG, IMM };
+  Kind kind;
+  int vreg;
+  long long value;
+  Operand() : kind(NONE), vreg(-1), value(0) {}
+};
+
 class Program_class;
 typedef Program_class *Program;
 class Decl_class;
@@ -59,6 +95,13 @@ typedef Actual_class *Actual;
 class Constant_class;
 typedef Constant_class *Constant;
 
+// used by the code generator to lower function bodies
+class IrFunction;
+class IrBuilder;
+struct IrBlock;
+// and to select leaq for sums
+struct Address;
+
 
 typedef list_node<VariableDecl> VariableDecls_class;
 typedef VariableDecls_class *VariableDecls;
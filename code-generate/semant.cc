@@ -0,0 +1,1185 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <math.h>
+#include "semant.h"
+#include "utilities.h"
+#include <map>
+#include <vector>
+
+extern int semant_debug;
+extern int cgen_optimize;
+extern char *curr_filename;
+
+static ostream& error_stream = cerr;
+int semant_errors = 0;
+static Decl curr_decl = 0;
+
+typedef SymbolTable<Symbol, Variable_class> ObjectEnvironment; // name, para or local
+ObjectEnvironment objectEnv;
+
+typedef std::map<Symbol, Symbol> CallTable;
+CallTable callTable;
+
+// globalVars stores global variables' name and declaration
+typedef std::map<Symbol, Variable> GlobalVariables;
+GlobalVariables globalVars;
+
+// locals of the function being checked, numbered in declaration order
+static int local_slots = 0;
+
+// MethodClass stores para type
+// MethodTable stores name and related paras
+typedef std::vector<Symbol> MethodClass;
+typedef std::map<Symbol, MethodClass> MethodTable;
+MethodTable methodTable;
+
+// InstallTable marks whether function is installed or not
+typedef std::map<Symbol, bool> InstallTable;
+InstallTable installTable;
+
+///////////////////////////////////////////////
+// helper func
+///////////////////////////////////////////////
+
+
+static ostream& semant_error() {
+    semant_errors++;
+    return error_stream;
+}
+
+// cgen-phase.cc counts lines from 1, the semant phase from 0
+static ostream& semant_error(tree_node *t) {
+    error_stream << t->get_line_number() << ": ";
+    return semant_error();
+}
+
+static ostream& internal_error(int lineno) {
+    error_stream << "FATAL:" << lineno << ": ";
+    return error_stream;
+}
+
+// a visible variable: locals and paras shadow globals, NULL if undefined
+static Variable lookup_var(Symbol name) {
+    Variable local = objectEnv.lookup(name);
+    if (local != NULL) {
+        return local;
+    }
+    GlobalVariables::iterator it = globalVars.find(name);
+    return it == globalVars.end() ? NULL : it->second;
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Symbols
+//
+// For convenience, a large number of symbols are predefined here.
+// These symbols include the primitive type and method names, as well
+// as fixed names used by the runtime system.
+//
+//////////////////////////////////////////////////////////////////////
+
+static Symbol 
+    Int,
+    Float,
+    String,
+    Bool,
+    Void,
+    Main,
+    print
+    ;
+
+bool isValidCallName(Symbol type) {
+    return type != (Symbol)print;
+}
+
+bool isValidTypeName(Symbol type) {
+    return type != Void;
+}
+
+//
+// Initializing the predefined symbols.
+//
+
+static void initialize_constants(void) {
+    // 4 basic types and Void type
+    Bool        = idtable.add_string("Bool");
+    Int         = idtable.add_string("Int");
+    String      = idtable.add_string("String");
+    Float       = idtable.add_string("Float");
+    Void        = idtable.add_string("Void");  
+    // main function
+    Main        = idtable.add_string("main");
+
+    // classical function to print things, so defined here for call.
+    print        = idtable.add_string("printf");
+}
+
+/*
+    TODO :
+    you should fill the following function defines, so that semant() can realize a semantic 
+    analysis in a recursive way. 
+    Of course, you can add any other functions to help.
+*/
+
+TypeKind type_kind(Symbol type) {
+    if (type == Int) return TYPE_INT;
+    if (type == Float) return TYPE_FLOAT;
+    if (type == Bool) return TYPE_BOOL;
+    if (type == String) return TYPE_STRING;
+    if (type == Void) return TYPE_VOID;
+    return TYPE_NONE;
+}
+
+// both kinds of an operator's operands in one switch label
+#define TYPE_PAIR(l, r) ((l) << 3 | (r))
+
+static bool is_number(Expr e) {
+    switch (e->getKind()) {
+    case TYPE_INT:
+    case TYPE_FLOAT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Int and Float operands mix into a Float result, other operands have to
+// be of the same type; false if they are not
+static bool arith_type(Expr e1, Expr e2, Symbol &result) {
+    switch (TYPE_PAIR(e1->getKind(), e2->getKind())) {
+    case TYPE_PAIR(TYPE_INT, TYPE_FLOAT):
+    case TYPE_PAIR(TYPE_FLOAT, TYPE_INT):
+        result = Float;
+        return true;
+    default:
+        result = e1->getType();
+        return e1->getType() == e2->getType();
+    }
+}
+
+static void install_calls(Decls decls) {
+    for (int i=decls->first(); decls->more(i); i=decls->next(i)) {
+        Symbol name = decls->nth(i)->getName();
+        Symbol type = decls->nth(i)->getType();
+        if (decls->nth(i)->isCallDecl()) {
+            if (callTable[name] != NULL) {
+                semant_error(decls->nth(i))<<"Function "<<name<<" was previously defined."<<endl;
+            } else if (type_kind(type) == TYPE_NONE) {
+                semant_error(decls->nth(i))<<"Function returnType error."<<endl;
+            } else if (!isValidCallName(name)) {
+                semant_error(decls->nth(i))<<"Function printf cannot have a name as printf"<<endl;
+            }
+            callTable[name] = type;
+            installTable[name] = false;
+            decls->nth(i)->check();
+        }
+    }
+}
+
+static void install_globalVars(Decls decls) {
+    int number = 0;
+    for (int i=decls->first(); decls->more(i); i=decls->next(i)) {
+        Symbol name = decls->nth(i)->getName();
+        Symbol type = decls->nth(i)->getType();
+        if (!decls->nth(i)->isCallDecl()) {
+            if (globalVars[name] != NULL) {
+                semant_error(decls->nth(i))<<"Global variable redefined."<<endl;
+            } else if (type == Void) {
+                semant_error(decls->nth(i))<<"var "<<name<<" cannot be of type Void. Void can just be used as return type."<<endl;
+            } else if (name == print) {
+                semant_error(decls->nth(i))<<"Variable printf cannot have a name as printf"<<endl;
+            }
+            Variable var = ((VariableDecl) decls->nth(i))->getVariable();
+            var->binding = Binding(Binding::STATIC, number++, name);
+            globalVars[name] = var;
+        }
+    }
+}
+
+static void check_calls(Decls decls) {
+    objectEnv.enterscope();
+    for (int i=decls->first(); decls->more(i); i=decls->next(i)) {
+        if (decls->nth(i)->isCallDecl()) {
+            decls->nth(i)->check();
+        }
+    }
+    objectEnv.exitscope();
+}
+
+static void check_main() {
+    if (callTable[Main] == NULL) {
+        semant_error()<<"main function is not defined."<<endl;
+    }
+}
+
+void VariableDecl_class::check() {
+    Symbol name = this->getName();
+    Symbol type = this->getType();
+    if (type == Void) {
+        semant_error()<<"var "<<name<<" cannot be of type Void. Void can just be used as return type."<<endl;
+    } else {
+        Variable var = this->getVariable();
+        var->binding = Binding(Binding::LOCAL, local_slots++, name);
+        objectEnv.addid(name, var);
+    }
+}
+
+void CallDecl_class::check() {
+    Variables vars = this->getVariables();
+    Symbol funcName = this->getName(); 
+    Symbol returnType = this->getType();
+    StmtBlock stmtblock = this->getBody();
+    
+    objectEnv.enterscope();
+    // install paras
+    if (installTable[name] == false) {
+        // methodclass stores paras type
+        MethodClass mclass;
+        for (int j=vars->first(); vars->more(j); j=vars->next(j)) {
+            Symbol name = vars->nth(j)->getName();
+            Symbol type = vars->nth(j)->getType();
+            
+            /* No need to check paras' type because of syntax rules */
+
+            // check if there are duplicated paras
+            if (objectEnv.lookup(name) != NULL) {
+                semant_error(this)<<"Function "<<funcName<< "'s parameter has a duplicate name "<<name<<endl;
+            }
+            objectEnv.addid(name, vars->nth(j));
+            mclass.push_back(type);
+        }
+
+        // methodTable map paras to funcname
+        methodTable[funcName] = mclass;
+        installTable[name] = true;
+    } else {
+        local_slots = 0;
+        int position = 0;
+        for (int j=vars->first(); vars->more(j); j=vars->next(j)) {
+            Symbol name = vars->nth(j)->getName();
+            
+            /* No need to check paras' type because of syntax rules */
+
+            // check if there are duplicated paras
+            if (objectEnv.lookup(name) != NULL) {
+                semant_error(this)<<"Function "<<funcName<< "'s parameter has a duplicate name "<<name<<endl;
+            }
+            vars->nth(j)->binding = Binding(Binding::PARA, position++, name);
+            objectEnv.addid(name, vars->nth(j));
+        }
+        // main function should not have any paras
+        if (funcName == Main && vars->len() != 0) {
+            semant_error(this)<<"Main function should not have paras"<<endl;
+        } else if (callTable[Main] != Void) {
+            semant_error(this)<<"main function should have return type Void."<<endl;
+        }
+
+        // check stmtBlock, its variableDecls are installed in a scope of their own
+        stmtblock->check(returnType);
+        if (!stmtblock->isReturn()) {
+            semant_error(this)<<"Function "<<name<<" must have an overall return statement."<<endl;
+        }
+        if (stmtblock->isBreak()) {
+            Stmts stmts = stmtblock->getStmts();
+            for (int i=stmts->first(); stmts->more(i); i=stmts->next(i)) {
+                if (stmts->nth(i)->isBreak()) {
+                    semant_error(stmts->nth(i))<<"break must be used in a loop sentence"<<endl;
+                }
+            }
+        }
+        if (stmtblock->isContinue()) {
+            Stmts stmts = stmtblock->getStmts();
+            for (int i=stmts->first(); stmts->more(i); i=stmts->next(i)) {
+                if (stmts->nth(i)->isContinue()) {
+                    semant_error(stmts->nth(i))<<"continue must be used in a loop sentence."<<endl;
+                }
+            }
+        }
+    }
+
+    objectEnv.exitscope();
+}
+
+void StmtBlock_class::check(Symbol type) {
+    VariableDecls varDecls = this->getVariableDecls();
+    Stmts stmts = this->getStmts(); 
+    objectEnv.enterscope();
+    for (int j=varDecls->first(); varDecls->more(j); j=varDecls->next(j)) {
+        varDecls->nth(j)->check();
+    }
+    for (int j=stmts->first(); stmts->more(j); j=stmts->next(j)) {
+        stmts->nth(j)->check(type);
+    }
+    objectEnv.exitscope();
+}
+
+void IfStmt_class::check(Symbol type) {
+    Expr condition = this->getCondition();
+    StmtBlock thenExpr = this->getThen();
+    StmtBlock elseExpr = this->getElse();
+    
+    // If condition should be Bool
+    Symbol conditionType = condition->checkType();
+    if (condition->getKind() != TYPE_BOOL) {
+        semant_error(this)<<"condition type should be Bool, but found"<<conditionType<<endl;
+    }
+
+    // check thenExpr and elseExpr
+    thenExpr->check(type);
+    elseExpr->check(type);
+}
+
+void WhileStmt_class::check(Symbol type) {
+    Expr condition = this->getCondition();
+    StmtBlock body = this->getBody();
+
+    // While condition should be Bool
+    Symbol conditionType = condition->checkType();
+    if (condition->getKind() != TYPE_BOOL) {
+        semant_error(this)<<"condition type should be Bool, but found"<<conditionType<<endl;
+    }
+
+    // check while body
+    body->check(type);
+}
+
+void ForStmt_class::check(Symbol type) {
+    Expr init = this->getInit();
+    Expr condition = this->getCondition();
+    Expr loop = this->getLoop();
+    StmtBlock body = this->getBody();
+
+    init->checkType();
+    loop->checkType();
+    // For condition should be Bool
+    Symbol conditionType = condition->checkType();
+    if (condition->getKind() != TYPE_BOOL) {
+        semant_error(this)<<"condition type should be Bool, but found"<<conditionType<<endl;
+    }
+
+    // check For body
+    body->check(type);
+}
+
+void ReturnStmt_class::check(Symbol type) {
+    Expr expr = this->getValue();
+    
+    // check if return Type match
+    Symbol returnType = expr->checkType();
+    if (expr->getKind() != TYPE_VOID) {
+        if (expr->is_empty_Expr() && type != Void) {
+            semant_error(this)<<"Returns Void, but need "<<type<<endl;
+        } else if (!expr->is_empty_Expr() && type != returnType) {
+            semant_error(this)<<"Returns "<<returnType<<" but need "<<type<<endl;
+        }
+    }
+}
+
+void ContinueStmt_class::check(Symbol type) {
+    
+}
+
+void BreakStmt_class::check(Symbol type) {
+
+}
+
+Symbol Call_class::checkType(){
+    Symbol name = this->getName();
+    Actuals actuals = this->getActuals();
+    unsigned int j = 0;
+    
+    if (name == print) {
+        if (actuals->len() == 0) {
+            semant_error(this)<<"printf() must has at last one parameter of type String."<<endl;
+            this->setType(Void);
+            return type;
+        }
+        Actual format = actuals->nth(actuals->first());
+        format->checkType();
+        for (int i=actuals->next(actuals->first()); actuals->more(i); i=actuals->next(i)) {
+            actuals->nth(i)->checkType();
+        }
+        if (format->getKind() != TYPE_STRING) {
+            semant_error(this)<<"printf()'s first parameter must be of type String."<<endl;
+            this->setType(Void);
+            return type;
+        }
+        this->setType(Void);
+        return type;
+    }
+
+    if (actuals->len() > 0){
+        if (actuals->len() != int(methodTable[name].size())) {
+            semant_error(this)<<"Wrong number of paras"<<endl;
+        }
+        for (int i=actuals->first(); actuals->more(i) && j<methodTable[name].size(); i=actuals->next(i)) {
+            Expr expr = actuals->nth(i)->copy_Expr();
+            Symbol sym = expr->checkType();
+            // check function call's paras fit funcdecl's paras
+            if (sym != methodTable[name][j]) {
+                semant_error(this)<<"Function "<<name<<", type "<<sym<<" does not conform to declared type "<<methodTable[name][j]<<endl;
+            }
+            j ++;
+            actuals->nth(i)->checkType();
+        }
+    }
+    
+    if (callTable[name] == NULL) {
+        semant_error(this)<<"Object "<<name<<" has not been defined"<<endl;
+        this->setType(Void);
+        return type;
+    } 
+    this->setType(callTable[name]);
+    return type;
+}
+
+Symbol Actual_class::checkType(){
+    Symbol sym = expr->checkType();
+    this->setType(sym);
+    return type;
+}
+
+Symbol Assign_class::checkType(){
+    Variable var = lookup_var(lvalue);
+    Symbol ls = NULL;
+    if (var == NULL) {
+        semant_error(this)<<"Undefined value"<<endl;
+    } else {
+        ls = var->getType();
+        binding = var->binding;
+    }
+    Symbol rs = value->checkType();
+    if (ls != rs) {
+        semant_error(this)<<"assign value mismatch"<<endl;
+    }    
+    this->setType(rs);
+    return type;
+}
+
+Symbol Add_class::checkType(){
+    e1->checkType();
+    e2->checkType();
+
+    Symbol result;
+    if (!arith_type(e1, e2, result)) {
+        semant_error(this)<<"lvalue and rvalue should have same type."<<endl;
+    }
+    this->setType(result);
+    return type;
+}
+
+Symbol Minus_class::checkType(){
+    e1->checkType();
+    e2->checkType();
+
+    Symbol result;
+    if (!arith_type(e1, e2, result)) {
+        semant_error(this)<<"Both lvalue and rvalue should be type Int"<<endl;
+    }
+    this->setType(result);
+    return type;
+}
+
+Symbol Multi_class::checkType(){
+    e1->checkType();
+    e2->checkType();
+
+    Symbol result;
+    if (!arith_type(e1, e2, result)) {
+        semant_error(this)<<"Both lvalue and rvalue should be type Int"<<endl;
+    }
+    this->setType(result);
+    return type;
+}
+
+Symbol Divide_class::checkType(){
+    e1->checkType();
+    e2->checkType();
+
+    Symbol result;
+    if (!arith_type(e1, e2, result)) {
+        semant_error(this)<<"Both lvalue and rvalue should be type Int"<<endl;
+    }
+    this->setType(result);
+    return type;
+}
+
+Symbol Mod_class::checkType(){
+    e1->checkType();
+    e2->checkType();
+
+    Symbol result;
+    if (!arith_type(e1, e2, result)) {
+        semant_error(this)<<"Both lvalue and rvalue should be type Int"<<endl;
+    }
+    this->setType(result);
+    return type;
+}
+
+Symbol Neg_class::checkType(){
+    Symbol sym = e1->checkType();
+    if (!is_number(e1)) {
+        semant_error(this)<<"Neg_class should have Int type"<<endl;
+        this->setType(Int);
+        return type;
+    }
+    this->setType(sym);
+    return type;
+}
+
+Symbol Lt_class::checkType(){
+    e1->checkType();
+    e2->checkType();
+    if (!is_number(e1) || !is_number(e2)) {
+        semant_error(this)<<"ltype mismatch rvalue"<<endl;
+    }
+    this->setType(Bool); 
+    return type;
+}
+
+Symbol Le_class::checkType(){
+    e1->checkType();
+    e2->checkType();
+    if (!is_number(e1) || !is_number(e2)) {
+        semant_error(this)<<"ltype mismatch rtype"<<endl;
+    }
+    this->setType(Bool); 
+    return type;
+}
+
+Symbol Equ_class::checkType(){
+    e1->checkType();
+    e2->checkType();
+    if (!(is_number(e1) && is_number(e2)) &&
+        !(e1->getKind() == TYPE_BOOL && e2->getKind() == TYPE_BOOL)) {
+        semant_error(this)<<"ltype mismatch rtype"<<endl;
+    }
+    this->setType(Bool); 
+    return type;
+}
+
+Symbol Neq_class::checkType(){
+    e1->checkType();
+    e2->checkType();
+    if (!(is_number(e1) && is_number(e2)) &&
+        !(e1->getKind() == TYPE_BOOL && e2->getKind() == TYPE_BOOL)) {
+        semant_error(this)<<"ltype mismatch rtype"<<endl;
+    }
+    this->setType(Bool); 
+    return type;
+}
+
+Symbol Ge_class::checkType(){
+    e1->checkType();
+    e2->checkType();
+    if (!is_number(e1) || !is_number(e2)) {
+        semant_error(this)<<"ltype mismatch rtype"<<endl;
+    }
+    this->setType(Bool); 
+    return type;
+}
+
+Symbol Gt_class::checkType(){
+    e1->checkType();
+    e2->checkType();
+    if (!is_number(e1) || !is_number(e2)) {
+        semant_error(this)<<"ltype mismatch rtype"<<endl;
+    }
+    this->setType(Bool); 
+    return type;
+}
+
+Symbol And_class::checkType(){
+    e1->checkType();
+    e2->checkType();
+
+    if (e1->getKind() != TYPE_BOOL || e2->getKind() != TYPE_BOOL) {
+        semant_error(this)<<"Both lvalue and rvalue should be type Bool"<<endl;
+    }
+    this->setType(Bool);
+    return type;
+}
+
+Symbol Or_class::checkType(){
+    e1->checkType();
+    e2->checkType();
+
+    if (e1->getKind() != TYPE_BOOL || e2->getKind() != TYPE_BOOL) {
+        semant_error(this)<<"Both lvalue and rvalue should be type Bool"<<endl;
+    }
+    this->setType(Bool);
+    return type;
+}
+
+Symbol Xor_class::checkType(){
+    Symbol ls = e1->checkType();
+    e2->checkType();
+
+    switch (TYPE_PAIR(e1->getKind(), e2->getKind())) {
+    case TYPE_PAIR(TYPE_BOOL, TYPE_BOOL):
+    case TYPE_PAIR(TYPE_INT, TYPE_INT):
+        break;
+    default:
+        semant_error(this)<<"Both lvalue and rvalue should be type Bool"<<endl;
+        this->setType(Bool);
+        return type;
+    }
+    this->setType(ls);
+    return type;
+}
+
+Symbol Not_class::checkType(){
+    Symbol sym = e1->checkType();
+    if (e1->getKind() != TYPE_BOOL) {
+        semant_error(this)<<"Not class should have Bool type"<<endl;
+    }
+
+    this->setType(sym);
+    return type;
+}
+
+Symbol Bitand_class::checkType(){
+    e1->checkType();
+    e2->checkType();
+
+    if (e1->getKind() != TYPE_INT || e2->getKind() != TYPE_INT) {
+        semant_error(this)<<"Bitand class should have Int type"<<endl;
+    }
+
+    this->setType(Int);
+    return type;
+}
+
+Symbol Bitor_class::checkType(){
+    e1->checkType();
+    e2->checkType();
+
+    if (e1->getKind() != TYPE_INT || e2->getKind() != TYPE_INT) {
+        semant_error(this)<<"Bitor class should have Int type"<<endl;
+    }
+
+    this->setType(Int);
+    return type;
+}
+
+Symbol Bitnot_class::checkType(){
+    e1->checkType();
+
+    if (e1->getKind() != TYPE_INT) {
+        semant_error(this)<<"Bitnot class should have Int type"<<endl;
+    }
+
+    this->setType(Int);
+    return type;
+}
+
+Symbol Const_int_class::checkType(){
+    setType(Int);
+    return type;
+}
+
+Symbol Const_string_class::checkType(){
+    setType(String);
+    return type;
+}
+
+Symbol Const_float_class::checkType(){
+    setType(Float);
+    return type;
+}
+
+Symbol Const_bool_class::checkType(){
+    setType(Bool);
+    return type;
+}
+
+Symbol Object_class::checkType(){
+    Variable v = lookup_var(var);
+    if (v == NULL) {
+        semant_error(this)<<"object "<<var<<" has not been defined."<<endl;
+        this->setType(Void);
+        return type;
+    }
+    binding = v->binding;
+    this->setType(v->getType());
+    return type;
+}
+
+Symbol No_expr_class::checkType(){
+    setType(Void);
+    return getType();
+}
+
+///////////////////////////////////////////////
+// constant folding
+///////////////////////////////////////////////
+
+/*
+    Under -O the checked tree is folded before code generation.  Constant
+    operands are evaluated the way the generated code would evaluate them:
+    Int arithmetic wraps at 64 bits, Floats are IEEE doubles and Int
+    operands of a Float operation are converted first.  Anything that
+    would trap at run time is left alone.  Identities only drop an operand
+    when evaluating it has no effect.
+*/
+
+enum Arith { ARITH_ADD, ARITH_SUB, ARITH_MUL, ARITH_DIV, ARITH_MOD };
+enum Relation { REL_LT, REL_LE, REL_EQ, REL_NE, REL_GE, REL_GT };
+
+// a constant standing in for the folded expression e
+static Expr int_constant(Expr e, long long v) {
+    Expr c = const_int(inttable.add_int(v));
+    c->set(e);
+    return c->setType(Int);
+}
+
+// NaN payloads do not survive the float table, those stay at run time
+static Expr float_constant(Expr e, double v) {
+    if (v != v) {
+        return e;
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.17g", v);
+    Expr c = const_float(floattable.add_string(buf));
+    c->set(e);
+    return c->setType(Float);
+}
+
+static Expr bool_constant(Expr e, bool v) {
+    Expr c = const_bool(v);
+    c->set(e);
+    return c->setType(Bool);
+}
+
+// an Int or Float constant as a double
+static bool number_value(Expr e, double &v) {
+    long long i;
+    if (e->int_value(i)) {
+        v = (double) i;
+        return true;
+    }
+    return e->float_value(v);
+}
+
+static Expr fold_int_arith(Expr e, Arith op, Expr e1, Expr e2) {
+    long long a, b;
+    bool ca = e1->int_value(a);
+    bool cb = e2->int_value(b);
+    if (ca && cb) {
+        unsigned long long ua = a, ub = b;
+        switch (op) {
+        case ARITH_ADD:
+            return int_constant(e, ua + ub);
+        case ARITH_SUB:
+            return int_constant(e, ua - ub);
+        case ARITH_MUL:
+            return int_constant(e, ua * ub);
+        default:
+            // idiv traps on these
+            if (b == 0 || (a == LLONG_MIN && b == -1)) {
+                return e;
+            }
+            return int_constant(e, op == ARITH_DIV ? a / b : a % b);
+        }
+    }
+
+    switch (op) {
+    case ARITH_ADD:
+        if (ca && a == 0) return e2;
+        if (cb && b == 0) return e1;
+        break;
+    case ARITH_SUB:
+        if (cb && b == 0) return e1;
+        break;
+    case ARITH_MUL:
+        if (ca && a == 1) return e2;
+        if (cb && b == 1) return e1;
+        if ((ca && a == 0 && e2->is_pure()) || (cb && b == 0 && e1->is_pure())) {
+            return int_constant(e, 0);
+        }
+        break;
+    case ARITH_DIV:
+        if (cb && b == 1) return e1;
+        break;
+    case ARITH_MOD:
+        // not x % -1, which traps when x is LLONG_MIN
+        if (cb && b == 1 && e1->is_pure()) {
+            return int_constant(e, 0);
+        }
+        break;
+    }
+    return e;
+}
+
+static Expr fold_float_arith(Expr e, Arith op, Expr e1, Expr e2) {
+    double a, b;
+    bool ca = number_value(e1, a);
+    bool cb = number_value(e2, b);
+    if (ca && cb) {
+        switch (op) {
+        case ARITH_ADD:
+            return float_constant(e, a + b);
+        case ARITH_SUB:
+            return float_constant(e, a - b);
+        case ARITH_MUL:
+            return float_constant(e, a * b);
+        case ARITH_DIV:
+            return float_constant(e, a / b);
+        default:
+            return e;
+        }
+    }
+
+    // x + -0.0, x - 0.0, x * 1.0 and x / 1.0 are x for every double x,
+    // including -0.0, infinities and NaN
+    bool f1 = e1->getKind() == TYPE_FLOAT;
+    bool f2 = e2->getKind() == TYPE_FLOAT;
+    switch (op) {
+    case ARITH_ADD:
+        if (ca && a == 0 && signbit(a) && f2) return e2;
+        if (cb && b == 0 && signbit(b) && f1) return e1;
+        break;
+    case ARITH_SUB:
+        if (cb && b == 0 && !signbit(b) && f1) return e1;
+        break;
+    case ARITH_MUL:
+        if (ca && a == 1 && f2) return e2;
+        if (cb && b == 1 && f1) return e1;
+        break;
+    case ARITH_DIV:
+        if (cb && b == 1 && f1) return e1;
+        break;
+    default:
+        break;
+    }
+    return e;
+}
+
+static Expr fold_arith(Expr e, Arith op, Expr e1, Expr e2) {
+    switch (e->getKind()) {
+    case TYPE_INT:
+        return fold_int_arith(e, op, e1, e2);
+    case TYPE_FLOAT:
+        return fold_float_arith(e, op, e1, e2);
+    default:
+        return e;
+    }
+}
+
+template <class T> static bool relate(Relation rel, T a, T b) {
+    switch (rel) {
+    case REL_LT: return a < b;
+    case REL_LE: return a <= b;
+    case REL_EQ: return a == b;
+    case REL_NE: return a != b;
+    case REL_GE: return a >= b;
+    default:     return a > b;
+    }
+}
+
+// Int operands compare as Ints, mixed ones as doubles; NaN compares
+// unordered as ucomisd does
+static Expr fold_compare(Expr e, Relation rel, Expr e1, Expr e2) {
+    long long i1, i2;
+    double f1, f2;
+    bool b1, b2;
+    if (e1->int_value(i1) && e2->int_value(i2)) {
+        return bool_constant(e, relate(rel, i1, i2));
+    }
+    if (number_value(e1, f1) && number_value(e2, f2)) {
+        return bool_constant(e, relate(rel, f1, f2));
+    }
+    if (e1->bool_value(b1) && e2->bool_value(b2)) {
+        return bool_constant(e, relate(rel, b1, b2));
+    }
+    return e;
+}
+
+// a branch that can never run
+static StmtBlock empty_block() {
+    return stmtBlock(nil_VariableDecls(), nil_Stmts());
+}
+
+Stmt StmtBlock_class::fold() {
+    for (int i=stmts->first(); stmts->more(i); i=stmts->next(i)) {
+        stmts->nth(i)->fold();
+    }
+    return this;
+}
+
+Stmt IfStmt_class::fold() {
+    condition = condition->fold();
+    thenexpr->fold();
+    elseexpr->fold();
+    bool taken;
+    if (condition->bool_value(taken)) {
+        if (taken) {
+            elseexpr = empty_block();
+        } else {
+            thenexpr = empty_block();
+        }
+    }
+    return this;
+}
+
+Stmt WhileStmt_class::fold() {
+    condition = condition->fold();
+    body->fold();
+    bool taken;
+    if (condition->bool_value(taken) && !taken) {
+        body = empty_block();
+    }
+    return this;
+}
+
+Stmt ForStmt_class::fold() {
+    initexpr = initexpr->fold();
+    condition = condition->fold();
+    loopact = loopact->fold();
+    body->fold();
+    bool taken;
+    if (condition->bool_value(taken) && !taken) {
+        body = empty_block();
+    }
+    return this;
+}
+
+Stmt ReturnStmt_class::fold() {
+    value = value->fold();
+    return this;
+}
+
+Stmt ContinueStmt_class::fold() {
+    return this;
+}
+
+Stmt BreakStmt_class::fold() {
+    return this;
+}
+
+Expr Call_class::fold() {
+    for (int i=actuals->first(); actuals->more(i); i=actuals->next(i)) {
+        actuals->nth(i)->fold();
+    }
+    return this;
+}
+
+Expr Actual_class::fold() {
+    expr = expr->fold();
+    return this;
+}
+
+Expr Assign_class::fold() {
+    value = value->fold();
+    return this;
+}
+
+Expr Add_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_arith(this, ARITH_ADD, e1, e2);
+}
+
+Expr Minus_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_arith(this, ARITH_SUB, e1, e2);
+}
+
+Expr Multi_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_arith(this, ARITH_MUL, e1, e2);
+}
+
+Expr Divide_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_arith(this, ARITH_DIV, e1, e2);
+}
+
+Expr Mod_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_arith(this, ARITH_MOD, e1, e2);
+}
+
+Expr Neg_class::fold() {
+    e1 = e1->fold();
+    long long i;
+    double f;
+    if (e1->int_value(i)) {
+        return int_constant(this, 0 - (unsigned long long) i);
+    }
+    if (e1->float_value(f)) {
+        return float_constant(this, -f);
+    }
+    return this;
+}
+
+Expr Lt_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_compare(this, REL_LT, e1, e2);
+}
+
+Expr Le_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_compare(this, REL_LE, e1, e2);
+}
+
+Expr Equ_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_compare(this, REL_EQ, e1, e2);
+}
+
+Expr Neq_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_compare(this, REL_NE, e1, e2);
+}
+
+Expr Ge_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_compare(this, REL_GE, e1, e2);
+}
+
+Expr Gt_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_compare(this, REL_GT, e1, e2);
+}
+
+// e2 only runs when e1 is true
+Expr And_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    bool v;
+    if (e1->bool_value(v)) {
+        return v ? e2 : e1;
+    }
+    if (e2->bool_value(v) && (v || e1->is_pure())) {
+        return v ? e1 : e2;
+    }
+    return this;
+}
+
+// e2 only runs when e1 is false
+Expr Or_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    bool v;
+    if (e1->bool_value(v)) {
+        return v ? e1 : e2;
+    }
+    if (e2->bool_value(v) && (!v || e1->is_pure())) {
+        return v ? e2 : e1;
+    }
+    return this;
+}
+
+Expr Xor_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    long long i1, i2;
+    bool b1, b2;
+    if (e1->int_value(i1) && e2->int_value(i2)) {
+        return int_constant(this, i1 ^ i2);
+    }
+    if (e1->bool_value(b1) && e2->bool_value(b2)) {
+        return bool_constant(this, b1 != b2);
+    }
+    return this;
+}
+
+Expr Not_class::fold() {
+    e1 = e1->fold();
+    bool v;
+    if (e1->bool_value(v)) {
+        return bool_constant(this, !v);
+    }
+    return this;
+}
+
+Expr Bitand_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    long long i1, i2;
+    if (e1->int_value(i1) && e2->int_value(i2)) {
+        return int_constant(this, i1 & i2);
+    }
+    return this;
+}
+
+Expr Bitor_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    long long i1, i2;
+    if (e1->int_value(i1) && e2->int_value(i2)) {
+        return int_constant(this, i1 | i2);
+    }
+    return this;
+}
+
+Expr Bitnot_class::fold() {
+    e1 = e1->fold();
+    long long i;
+    if (e1->int_value(i)) {
+        return int_constant(this, ~i);
+    }
+    return this;
+}
+
+Expr Const_int_class::fold() {
+    return this;
+}
+
+Expr Const_string_class::fold() {
+    return this;
+}
+
+Expr Const_float_class::fold() {
+    return this;
+}
+
+Expr Const_bool_class::fold() {
+    return this;
+}
+
+Expr Object_class::fold() {
+    return this;
+}
+
+Expr No_expr_class::fold() {
+    return this;
+}
+
+static void fold_calls(Decls decls) {
+    for (int i=decls->first(); decls->more(i); i=decls->next(i)) {
+        if (decls->nth(i)->isCallDecl()) {
+            ((CallDecl) decls->nth(i))->getBody()->fold();
+        }
+    }
+}
+
+void Program_class::semant() {
+    initialize_constants();
+    install_calls(decls);
+    check_main();
+    install_globalVars(decls);
+    check_calls(decls);
+    
+    if (semant_errors > 0) {
+        cerr << "Compilation halted due to static semantic errors." << endl;
+        exit(1);
+    }
+
+    if (cgen_optimize) {
+        fold_calls(decls);
+    }
+}
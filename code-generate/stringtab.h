@@ -11,6 +11,7 @@
 
 #include <assert.h>
 #include <string.h>
+#include <vector>
 #include "list.h"    // list template
 #include "seal-io.h"
 
@@ -73,17 +74,23 @@ public:
 };
 
 class IntEntry: public Entry {
+protected:
+  long long value;   // the constant, read once when it is entered
 public:
   void code_def(ostream& str);
   void code_ref(ostream& str);
   IntEntry(char *s, int l, int i);
+  long long get_value() const { return value; }
 };
 
 class FloatEntry: public Entry {
+protected:
+  double value;      // the constant, read once when it is entered
 public:
   void code_def(ostream& str);
   void code_ref(ostream& str);
   FloatEntry(char *s, int l, int i);
+  double get_value() const { return value; }
 };
 
 typedef StringEntry *StringEntryP;
@@ -102,6 +109,22 @@ class StringTable
 protected:
    List<Elem> *tbl;   // a string table is a list
    int index;         // the current index
+
+   //
+   // The list is indexed by an open-addressed hash table.  Each bucket
+   // caches the hash of its entry, so a probe only compares strings when
+   // the full hashes match.  entries[i] is the entry with index i.
+   //
+   struct Bucket {
+      unsigned hash;
+      Elem *elem;
+   };
+   std::vector<Bucket> buckets;
+   std::vector<Elem *> entries;
+
+   static unsigned hash_string(char *s, int len);
+   int find_slot(char *s, int len, unsigned hash);
+   void grow();
 public:
    StringTable(): tbl((List<Elem> *) NULL), index(0) { }   // an empty table
    // The following methods each add a string to the string table.  
@@ -115,7 +138,7 @@ public:
    Elem *add_string(char *s);
 
    // add the string representation of an integer
-   Elem *add_int(long i);
+   Elem *add_int(long long i);
 
 
    // An iterator.
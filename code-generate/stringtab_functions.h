@@ -5,56 +5,122 @@
 #include "copyright.h"
 
 #include "seal-io.h"
-#define MAXSIZE 1000000
-#define min(a,b) (a > b ? b : a)
-
 #include "stringtab.h"
 #include <stdio.h>
 
+
 //
 // A string table is implemented a linked list of Entrys.  Each Entry
-// in the list has a unique string.
+// in the list has a unique string.  The list is searched through a hash
+// index kept alongside it, and entries are also recorded in a vector
+// ordered by their index.
+//
+
+#define INITIAL_BUCKETS 64
+
+//
+// FNV-1a over the first len characters of s.
+//
+template <class Elem>
+unsigned StringTable<Elem>::hash_string(char *s, int len)
+{
+  unsigned h = 2166136261u;
+  for (int i = 0; i < len; i++) {
+    h ^= (unsigned char) s[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+//
+// Probe for the string s of length len.  Returns the slot holding the
+// matching entry, or the empty slot where it would be inserted.
 //
+template <class Elem>
+int StringTable<Elem>::find_slot(char *s, int len, unsigned hash)
+{
+  int mask = buckets.size() - 1;
+  int slot = hash & mask;
+  while (buckets[slot].elem) {
+    if (buckets[slot].hash == hash && buckets[slot].elem->equal_string(s,len))
+      return slot;
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+//
+// Double the number of buckets and reinsert every entry, reusing the
+// stored hashes.
+//
+template <class Elem>
+void StringTable<Elem>::grow()
+{
+  std::vector<Bucket> old;
+  old.swap(buckets);
+  Bucket empty = { 0, NULL };
+  buckets.assign(old.empty() ? INITIAL_BUCKETS : old.size() * 2, empty);
+
+  int mask = buckets.size() - 1;
+  for (size_t i = 0; i < old.size(); i++) {
+    if (!old[i].elem)
+      continue;
+    int slot = old[i].hash & mask;
+    while (buckets[slot].elem)
+      slot = (slot + 1) & mask;
+    buckets[slot] = old[i];
+  }
+}
 
 template <class Elem>
 Elem *StringTable<Elem>::add_string(char *s)
 {
- return add_string(s,MAXSIZE);
+ return add_string(s,strlen(s));
 }
 
 //
-// Add a string requires two steps.  First, the list is searched; if the
-// string is found, a pointer to the existing Entry for that string is 
+// Add a string requires two steps.  First, the table is searched; if the
+// string is found, a pointer to the existing Entry for that string is
 // returned.  If the string is not found, a new Entry is created and added
-// to the list.
+// to the list.  Only the first maxchars characters of s are looked at, so
+// s may be a slice of a longer buffer that is not terminated after it.
 //
 template <class Elem>
 Elem *StringTable<Elem>::add_string(char *s, int maxchars)
 {
-  int len = min((int) strlen(s),maxchars);
-  for(List<Elem> *l = tbl; l; l = l->tl())
-    if (l->hd()->equal_string(s,len))
-      return l->hd();
+  int len = strnlen(s,maxchars);
+  unsigned hash = hash_string(s,len);
+
+  // keep the load factor at or below one half
+  if ((size_t) (index + 1) * 2 > buckets.size())
+    grow();
+
+  int slot = find_slot(s,len,hash);
+  if (buckets[slot].elem)
+    return buckets[slot].elem;
 
   Elem *e = new Elem(s,len,index++);
   tbl = new List<Elem>(e, tbl);
+  entries.push_back(e);
+  buckets[slot].hash = hash;
+  buckets[slot].elem = e;
   return e;
 }
 
 //
-// To look up a string, the list is scanned until a matching Entry is located.
-// If no such entry is found, an assertion failure occurs.  Thus, this function
-// is used only for strings that one expects to find in the table.
+// To look up a string, the hash index is probed until a matching Entry is
+// located.  If no such entry is found, an assertion failure occurs.  Thus,
+// this function is used only for strings that one expects to find in the
+// table.
 //
 template <class Elem>
 Elem *StringTable<Elem>::lookup_string(char *s)
 {
   int len = strlen(s);
-  for(List<Elem> *l = tbl; l; l = l->tl())
-    if (l->hd()->equal_string(s,len))
-      return l->hd();
-  assert(0);   // fail if string is not found
-  return NULL; // to avoid compiler warning
+  assert(!buckets.empty());   // fail if the table is empty
+  int slot = find_slot(s,len,hash_string(s,len));
+  assert(buckets[slot].elem);   // fail if string is not found
+  return buckets[slot].elem;
 }
 
 //
@@ -64,21 +130,18 @@ Elem *StringTable<Elem>::lookup_string(char *s)
 template <class Elem>
 Elem *StringTable<Elem>::lookup(int ind)
 {
-  for(List<Elem> *l = tbl; l; l = l->tl())
-    if (l->hd()->equal_index(ind))
-      return l->hd();
-  assert(0);   // fail if string is not found
-  return NULL; // to avoid compiler warning
+  assert(ind >= 0 && ind < index);   // fail if string is not found
+  return entries[ind];
 }
 
 //
 // add_int adds the string representation of an integer to the list.
 //
 template <class Elem>
-Elem *StringTable<Elem>::add_int(long i)
+Elem *StringTable<Elem>::add_int(long long i)
 {
-  static char *buf = new char[20];
-  snprintf(buf, 20, "%ld", i);
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%lld", i);
   return add_string(buf);
 }
 template <class Elem>
@@ -14,6 +14,9 @@
 #ifndef _SYMTAB_H_
 #define _SYMTAB_H_
 
+#include <deque>
+#include <vector>
+#include <functional>
 #include "list.h"
 
 //
@@ -34,55 +37,87 @@ public:
 
 //
 // SymbolTable<SYM,DAT> describes a symbol table mapping symbols of
-//    type `SYM' to data of type `DAT *'.  It is implemented as a
-//    list of lists of `SymtabEntry<SYM,DAT> *'.  The inner list is
-//    a scope, a mapping from symbols to data, and the outer list is
-//    a list of scopes. 
+//    type `SYM' to data of type `DAT *'.  Every binding ever added and
+//    still in scope sits in `log', in the order it was added.  An
+//    open-addressed hash table keyed on the symbol points at the
+//    innermost binding of each symbol, and every binding remembers the
+//    one it shadows.  `scopes' holds the length of the log at each
+//    enterscope.
 //
-//    `tbl' points to the current top scope.
+//    `enterscope' starts a new scope nested in the current one.
 //
-//    `enterscope' makes the table point to a new scope whose parent
-//       is the scope it pointed to previously.
-//
-//    `exitscope' makes the table point to the parent scope of the
-//        current scope.  Note that the old child scope is not
-//        deallocated.  One may save the state of a symbol table
-//        at a given point by copying it with `operator ='
+//    `exitscope' drops the bindings of the current scope from the end
+//        of the log, pointing the hash table back at the bindings they
+//        shadowed.  One may save the state of a symbol table at a given
+//        point by copying it; the copy is independent of the original.
 //
 //    `addid(s,i)' adds a symbol table entry to the current scope of
-//        the symbol table mapping symbol `s' to data `d'.  The old
-//        top scope isn't modified; a new scope is created whose
-//        entry list is the new entry followed by the old entry list,
-//        and whose tail is the old top scope's parent.  The table
-//        is made to point to this new scope.
+//        the symbol table mapping symbol `s' to data `d'.  The entry
+//        stays at the same address until its scope is exited.
 //
-//    `lookup(s)' looks for the symbol `s', starting at the top scope
-//        and proceeding down the list of scopes until either an
-//        entry is found whose `get_id()' equals `s', or the end of
-//        the root scope is reached.  It returns the data item
-//        associated with the entry, or NULL if no such entry exists.
+//    `lookup(s)' returns the data item of the innermost entry whose
+//        `get_id()' equals `s', or NULL if no such entry exists.
 //
-//    
-//    `probe(s)' checks the top scope for an entry whose `get_id()'
-//        equals `s', and returns the entry's `get_info()' if
-//        found, and NULL otherwise.
+//    `probe(s)' returns the data item of the entry for `s' in the top
+//        scope, or NULL if it has none.
 //
 //    `dump()' prints the symbols in the symbol table.
 //
+//    lookup, probe and addid take constant time on average, exitscope
+//    takes time proportional to the size of the scope it drops.
+//
 
 template <class SYM, class DAT>
 class SymbolTable
 {
    typedef SymtabEntry<SYM,DAT> ScopeEntry;
-   typedef List<ScopeEntry> Scope;
-   typedef List<Scope> ScopeList;
 private:
-   ScopeList  *tbl;
-public:
-   SymbolTable(): tbl(NULL) { }     // create a new symbol table
+   struct Binding {
+      ScopeEntry entry;
+      int shadowed;      // index in log of the binding hidden by this one, or -1
+      Binding(SYM s, DAT *i, int sh) : entry(s, i), shadowed(sh) { }
+   };
+   struct Bucket {
+      bool used;         // a symbol has been hashed to this bucket
+      SYM id;
+      int top;           // index in log of the innermost binding of id, or -1
+   };
+
+   std::deque<Binding> log;
+   std::vector<int> scopes;
+   std::vector<Bucket> buckets;
+   int used_buckets;
+
+   static size_t hash(SYM s, size_t mask)
+   {
+       // spread the bits of pointers, whose low bits are always zero
+       unsigned long long h = std::hash<SYM>()(s);
+       return (size_t) ((h * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+   }
+
+   // the bucket of s, or the empty one where it would go
+   Bucket &find(SYM s)
+   {
+       size_t mask = buckets.size() - 1;
+       size_t b = hash(s, mask);
+       while (buckets[b].used && !(buckets[b].id == s))
+	   b = (b + 1) & mask;
+       return buckets[b];
+   }
+
+   void grow()
+   {
+       std::vector<Bucket> old;
+       old.swap(buckets);
+       Bucket empty = { false, SYM(), -1 };
+       buckets.assign(old.empty() ? 16 : old.size() * 2, empty);
+       for (size_t i = 0; i < old.size(); i++)
+	   if (old[i].used)
+	       find(old[i].id) = old[i];
+   }
 
-   // Create pointer to current symbol table.
-   SymbolTable &operator =(const SymbolTable &s) { tbl = s.tbl; return *this; }
+public:
+   SymbolTable() : used_buckets(0) { grow(); }   // create a new symbol table
 
    void fatal_error(char * msg)
    {
@@ -90,36 +125,45 @@ public:
      exit(1);
    } 
 
-   // Enter a new scope.  A symbol table is organized as a list of
-   // lists.  The head of the list is the innermost scope, the tail
-   // holds the outer scopes.  A scope must be entered before anything
-   // can be added to the table.
-
+   // Enter a new scope.  A scope must be entered before anything can be
+   // added to the table.
    void enterscope()
    {
-       // The cast of NULL is required for template instantiation to work
-       // correctly.
-       tbl = new ScopeList((Scope *) NULL, tbl);
+       scopes.push_back(log.size());
    }
 
-   // Pop the first scope off of the symbol table.
+   // Pop the innermost scope off of the symbol table.
    void exitscope()
    {
        // It is an error to exit a scope that doesn't exist.
-       if (tbl == NULL) {
+       if (scopes.empty()) {
 	   fatal_error("exitscope: Can't remove scope from an empty symbol table.");
        }
-       tbl = tbl->tl();
+       while ((int) log.size() > scopes.back()) {
+	   Binding &b = log.back();
+	   find(b.entry.get_id()).top = b.shadowed;
+	   log.pop_back();
+       }
+       scopes.pop_back();
    }
 
    // Add an item to the symbol table.
    ScopeEntry *addid(SYM s, DAT *i)
    {
        // There must be at least one scope to add a symbol.
-       if (tbl == NULL) fatal_error("addid: Can't add a symbol without a scope.");
-       ScopeEntry * se = new ScopeEntry(s,i);
-       tbl = new ScopeList(new Scope(se, tbl->hd()), tbl->tl());
-       return(se);
+       if (scopes.empty()) fatal_error("addid: Can't add a symbol without a scope.");
+       if ((size_t) (used_buckets + 1) * 2 > buckets.size())
+	   grow();
+       Bucket &b = find(s);
+       if (!b.used) {
+	   b.used = true;
+	   b.id = s;
+	   b.top = -1;
+	   used_buckets++;
+       }
+       log.push_back(Binding(s, i, b.top));
+       b.top = log.size() - 1;
+       return &log.back().entry;
    }
    
    // Lookup an item through all scopes of the symbol table.  If found
@@ -128,43 +172,38 @@ public:
 
    DAT * lookup(SYM s)
    {
-       for(ScopeList *i = tbl; i != NULL; i=i->tl()) {
-	   for( Scope *j = i->hd(); j != NULL; j = j->tl()) {
-	       if (s == j->hd()->get_id()) {
-		   return (j->hd()->get_info());
-	       }
-	   }
-       }
-       return NULL;
+       Bucket &b = find(s);
+       if (!b.used || b.top < 0)
+	   return NULL;
+       return log[b.top].entry.get_info();
    }
 
    // probe the symbol table.  Check the top scope (only) for the item
    // 's'.  If found, return the information field.  If not return NULL.
    DAT *probe(SYM s)
    {
-       if (tbl == NULL) {
+       if (scopes.empty()) {
 	   fatal_error("probe: No scope in symbol table.");
        }
-       for(Scope *i = tbl->hd(); i != NULL; i = i->tl()) {
-	   if (s == i->hd()->get_id()) {
-	       return(i->hd()->get_info());
-	   }
-       }
-       return(NULL);
+       Bucket &b = find(s);
+       if (!b.used || b.top < scopes.back())
+	   return NULL;
+       return log[b.top].entry.get_info();
    }
 
    // Prints out the contents of the symbol table  
    void dump()
    {
-      for(ScopeList *i = tbl; i != NULL; i = i->tl()) {
+      int end = log.size();
+      for (int k = scopes.size() - 1; k >= 0; k--) {
          cerr << "\nScope: \n";
-         for(Scope *j = i->hd(); j != NULL; j = j->tl()) {
-            cerr << "  " << j->hd()->get_id() << endl;
+         for (int j = end - 1; j >= scopes[k]; j--) {
+            cerr << "  " << log[j].entry.get_id() << endl;
          }
+         end = scopes[k];
       }
    }
  
 };
 
 #endif
-
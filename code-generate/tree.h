@@ -15,9 +15,52 @@
 ///////////////////////////////////////////////////////////////////////////
  
 
+#include <stddef.h>
+#include <vector>
 #include "stringtab.h"
 #include "seal-io.h"
 
+/////////////////////////////////////////////////////////////////////
+//
+//  NodeArena
+//
+//   Every tree_node, list nodes included, is allocated from the
+//   bump-pointer arena tree_arena instead of the heap.  Nodes live
+//   until the end of the compile, so nothing is given back one node
+//   at a time:
+//
+//       void release()
+//         runs the destructors of all nodes and frees the arena in one
+//         call; the phase driver calls it once it is done with the tree.
+//
+//       void stats(ostream& s)
+//         prints the bytes allocated and how many nodes of each class
+//         are in the arena.
+//
+/////////////////////////////////////////////////////////////////////
+class NodeArena {
+private:
+    struct Chunk {
+	Chunk *next;
+	size_t size;            // bytes for nodes after the header
+	size_t used;
+    };
+    Chunk *chunks;              // most recent first
+    size_t bytes;               // handed out to nodes, headers included
+    int nodes;
+
+    Chunk *new_chunk(size_t size);
+    static char *data(Chunk *c);  // where the nodes of c start
+public:
+    NodeArena() : chunks(NULL), bytes(0), nodes(0) { }
+    void *allocate(size_t size);
+    void free(void *p);
+    void release();
+    void stats(ostream& s);
+};
+
+extern NodeArena tree_arena;
+
 /////////////////////////////////////////////////////////////////////
 //
 //  tree_node
@@ -59,6 +102,9 @@ public:
     virtual void dump(ostream& stream, int n) = 0;
     int get_line_number();
     tree_node *set(tree_node *);
+
+    static void *operator new(size_t size) { return tree_arena.allocate(size); }
+    static void operator delete(void *p) { tree_arena.free(p); }
 };
 
 ///////////////////////////////////////////////////////////////////
@@ -93,10 +139,15 @@ public:
 //     int len()
 //     returns the length of the list
 //
+//     Both nth and len run in constant time.  The first time either is
+//     called on a list, its elements are flattened into a vector that is
+//     kept with the node; list nodes are never modified after they are
+//     built, so the vector stays valid.
+//
 //     nth_length(int n, int &len);
 //     Returns the nth element of the list or NULL if there are not n elements.
-//     "len" is set to the length of the list.  This method is used internally
-//     by the APS package to efficiently traverse the list representation.  
+//     "len" is set to the length of the list.  This walks the list
+//     representation directly and does not use the flattened vector.
 //
 //     static list_node<Elem> *nil();
 //     static list_node<Elem> *single(Elem);
@@ -113,7 +164,12 @@ public:
 //////////////////////////////////////////////////////////////////////////////
 
 template <class Elem> class list_node : public tree_node {
+private:
+    std::vector<Elem> *elems;    // flattened elements; NULL until needed
+protected:
+    std::vector<Elem> &flat();
 public:
+    list_node() : elems(NULL) { }
     tree_node *copy()            { return copy_list(); }
     Elem nth(int n);
     //
@@ -124,10 +180,15 @@ public:
     int more(int n)  { return (n < len()); }
 
     virtual list_node<Elem> *copy_list() = 0;
-    virtual ~list_node() { }
+    virtual ~list_node() { delete elems; }
     virtual int len() = 0;
     virtual Elem nth_length(int n, int &len) = 0;
 
+    // Push the elements of this node onto out, or its sublists onto work
+    // (last to be visited first); used by flat().
+    virtual void expand(std::vector<list_node<Elem> *> &work,
+                        std::vector<Elem> &out) = 0;
+
     static list_node<Elem> *nil();
     static list_node<Elem> *single(Elem);
     static list_node<Elem> *append(list_node<Elem> *l1,list_node<Elem> *l2);
@@ -142,6 +203,7 @@ public:
     list_node<Elem> *copy_list();
     int len();
     Elem nth_length(int n, int &len);
+    void expand(std::vector<list_node<Elem> *> &, std::vector<Elem> &) { }
     void dump(ostream& stream, int n);
 };
 
@@ -154,6 +216,9 @@ public:
     list_node<Elem> *copy_list();
     int len();
     Elem nth_length(int n, int &len);
+    void expand(std::vector<list_node<Elem> *> &, std::vector<Elem> &out) {
+	out.push_back(elem);
+    }
     void dump(ostream& stream, int n);
 };
 
@@ -168,8 +233,11 @@ public:
     }
     list_node<Elem> *copy_list();
     int len();
-    Elem nth(int n);
     Elem nth_length(int n, int &len);
+    void expand(std::vector<list_node<Elem> *> &work, std::vector<Elem> &) {
+	work.push_back(rest);
+	work.push_back(some);
+    }
     void dump(ostream& stream, int n);
 };
 
@@ -196,29 +264,43 @@ template <class Elem> list_node<Elem> *list_node<Elem>::append(list_node<Elem> *
 
 template <class Elem> Elem list_node<Elem>::nth(int n)
 {
-    int len;
-    Elem tmp = nth_length(n ,len);
+    std::vector<Elem> &v = flat();
 
-    if (tmp)
-	return tmp;
+    if (n >= 0 && n < (int) v.size())
+	return v[n];
     else {
 	cerr << "error: outside the range of the list\n";
 	exit(1);
     }
 }
 
-// added 10/30/06 cgs
-template <class Elem> Elem append_node<Elem>::nth(int n)
-{
-    int len;
-    Elem tmp = nth_length(n ,len);
 
-    if (tmp)
-	return tmp;
-    else {
-	cerr << "error: outside the range of the list\n";
-	exit(1);
+///////////////////////////////////////////////////////////////////////////
+//
+// list_node::flat
+//
+// return the elements of the list in order, flattening the list on the
+// first call.  Append chains built by left-recursive grammar rules can be
+// as deep as the list is long, so the walk uses an explicit work stack.
+// Sublists that are already flattened are copied in one step.
+//
+///////////////////////////////////////////////////////////////////////////
+template <class Elem> std::vector<Elem> &list_node<Elem>::flat()
+{
+    if (elems)
+	return *elems;
+
+    elems = new std::vector<Elem>();
+    std::vector<list_node<Elem> *> work(1, this);
+    while (!work.empty()) {
+	list_node<Elem> *l = work.back();
+	work.pop_back();
+	if (l != this && l->elems)
+	    elems->insert(elems->end(), l->elems->begin(), l->elems->end());
+	else
+	    l->expand(work, *elems);
     }
+    return *elems;
 }
 
 ///////////////////////////////////////////////////////////////////////////
@@ -353,7 +435,7 @@ template <class Elem> list_node<Elem> *append_node<Elem>::copy_list()
 ///////////////////////////////////////////////////////////////////////////
 template <class Elem> int append_node<Elem>::len()
 {
-    return some->len() + rest->len();
+    return this->flat().size();
 }
 
 
@@ -391,7 +473,7 @@ template <class Elem> void append_node<Elem>::dump(ostream& stream, int n)
     size = len();
     stream << pad(n) << "list\n";
     for (i = 0; i < size; i++)
-      nth(i)->dump(stream, n+2);
+      this->nth(i)->dump(stream, n+2);
     stream << pad(n) << "(end_of_list)\n";
 }
 
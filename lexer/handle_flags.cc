@@ -25,6 +25,8 @@
 extern int yy_flex_debug;       // for the lexer; prints recognized rules
 extern int seal_yydebug;        // for the parser
        int lex_verbose;         // also for the lexer; prints tokens
+       int lex_handwritten;     // scan with seal-scan.cc instead of flex
+       int lex_diff;            // lextest compares the two scanners
        int semant_debug;        // for semantic analysis
        int cgen_debug;          // for code gen
        bool disable_reg_alloc;  // Don't do register allocation
@@ -47,13 +49,15 @@ void handle_flags(int argc, char *argv[]) {
   yy_flex_debug = 0;
   seal_yydebug = 0;
   lex_verbose  = 0;
+  lex_handwritten = 0;
+  lex_diff = 0;
   semant_debug = 0;
   cgen_debug = 0;
   cgen_optimize = 0;
   disable_reg_alloc = 0;
   
 
-  while ((c = getopt(argc, argv, "lpscvrOo:gtT")) != -1) {
+  while ((c = getopt(argc, argv, "lpscvrOo:gtTHD")) != -1) {
     switch (c) {
 #ifdef DEBUG
     case 'l':
@@ -99,6 +103,12 @@ void handle_flags(int argc, char *argv[]) {
     case 'O':  // enable optimization
       cgen_optimize = 1;
       break;
+    case 'H':  // use the hand-written scanner
+      lex_handwritten = 1;
+      break;
+    case 'D':  // compare the hand-written scanner with flex
+      lex_diff = 1;
+      break;
     case '?':
       unknownopt = 1;
       break;
@@ -111,9 +121,9 @@ void handle_flags(int argc, char *argv[]) {
   if (unknownopt) {
       cerr << "usage: " << argv[0] << 
 #ifdef DEBUG
-	  " [-lvpscOgtTr -o outname] [input-files]\n";
+	  " [-lvpscOgtTrHD -o outname] [input-files]\n";
 #else
-      " [-OgtT -o outname] [input-files]\n";
+      " [-OgtTHD -o outname] [input-files]\n";
 #endif
       exit(1);
   }
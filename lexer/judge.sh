@@ -2,8 +2,17 @@
 cd test
 for filename in *.seal; do
     echo "--------Test using" $filename "--------"
-    ../lexer $filename > tempfile
-    diff tempfile ../test-answer/$filename.out > /dev/null
+    for flags in "" -H; do
+        ../lexer $flags $filename > tempfile
+        diff tempfile ../test-answer/$filename.out > /dev/null
+        if [ $? -eq 0 ] ; then
+            echo passed
+        else
+            echo NOT passed
+        fi
+    done
+    # -D exits non-zero when flex and seal-scan.cc disagree on a token
+    ../lexer -D $filename > tempfile
     if [ $? -eq 0 ] ; then
         echo passed
     else
@@ -11,4 +20,4 @@ for filename in *.seal; do
     fi
 done
 rm -f tempfile
-cd ..
\ No newline at end of file
+cd ..
@@ -11,10 +11,16 @@
 //  Reads input from file argument.
 //
 //  Option -l prints summary of flex actions.
+//  Option -H scans with the hand-written scanner in seal-scan.cc.
+//  Option -D scans every file with both scanners and prints the tokens
+//  on which they disagree.
 //
 //////////////////////////////////////////////////////////////////////////////
 
 #include <stdio.h>      // needed on Linux system
+#include <sstream>
+#include <string>
+#include <vector>
 #include <unistd.h>     // for getopt
 #include "seal-parse.h" // bison-generated file; defines tokens
 #include "utilities.h"
@@ -28,10 +34,13 @@ char *curr_filename = "<stdin>"; // this name is arbitrary
 FILE *fin;   // This is the file pointer from which the lexer reads its input.
 
 //
-//  seal_yylex() is the function produced by flex. It returns the next
-//  token each time it is called.
+//  seal_yylex() returns the next token each time it is called.  It is the
+//  function produced by flex, which hands the call on to seal_scan_yylex()
+//  when -H sets seal_yylex_hook.
 //
 extern int seal_yylex();
+extern int seal_scan_yylex();
+extern int (*seal_yylex_hook)();
 YYSTYPE seal_yylval;           // Not compiled with parser, so must define this.
 
 extern int optind;  // used for option processing (man 3 getopt for more info)
@@ -42,6 +51,8 @@ extern int optind;  // used for option processing (man 3 getopt for more info)
 //
 extern int yy_flex_debug;      // Flex debugging; see flex documentation.
 extern int lex_verbose;        // Controls printing of tokens.
+extern int lex_handwritten;    // Scan with seal-scan.cc.
+extern int lex_diff;           // Compare the two scanners.
 void handle_flags(int argc, char *argv[]);
 
 //
@@ -57,11 +68,69 @@ extern void dump_seal_token(ostream& out, int lineno,
 			    int token, YYSTYPE yylval);
 
 
+//
+//  The token dump of one file, one line per token.
+//
+static std::vector<std::string> scan_tokens(char *filename, int (*lex)())
+{
+	std::vector<std::string> tokens;
+	int token;
+
+	fin = fopen(filename, "r");
+	if (fin == NULL) {
+	    cerr << "Could not open input file " << filename << endl;
+	    exit(1);
+	}
+	curr_lineno = 1;
+	while ((token = lex()) != 0) {
+	    std::ostringstream line;
+	    dump_seal_token(line, curr_lineno, token, seal_yylval);
+	    tokens.push_back(line.str());
+	}
+	fclose(fin);
+	return tokens;
+}
+
+//
+//  Print the tokens on which flex and the hand-written scanner disagree,
+//  flex's marked with '<' and the other one's with '>'.  Returns the
+//  number of differences.
+//
+static int diff_scanners(char *filename)
+{
+	std::vector<std::string> flex = scan_tokens(filename, seal_yylex);
+	std::vector<std::string> hand = scan_tokens(filename, seal_scan_yylex);
+	int differences = 0;
+
+	cout << "#name \"" << filename << "\"" << endl;
+	for (size_t i = 0; i < flex.size() || i < hand.size(); i++) {
+	    if (i < flex.size() && i < hand.size() && flex[i] == hand[i])
+		continue;
+	    differences++;
+	    if (i < flex.size())
+		cout << "< " << flex[i];
+	    if (i < hand.size())
+		cout << "> " << hand[i];
+	}
+	cout << "#" << flex.size() << " tokens, " << differences
+	     << " differences" << endl;
+	return differences;
+}
+
 int main(int argc, char** argv) {
 	int token;
+	int differences = 0;
 	
 	handle_flags(argc,argv);
 
+	if (lex_diff) {
+	    for (; optind < argc; optind++)
+		differences += diff_scanners(argv[optind]);
+	    exit(differences != 0);
+	}
+	if (lex_handwritten)
+	    seal_yylex_hook = seal_scan_yylex;
+
 	while (optind < argc) {
 	    fin = fopen(argv[optind], "r");
 	    if (fin == NULL) {
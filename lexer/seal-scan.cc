@@ -0,0 +1,602 @@
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  seal-scan.cc
+//
+//  A hand-written scanner for seal, selected with -H instead of the flex
+//  scanner built from seal.flex.  It returns the same tokens and sets
+//  seal_yylval and curr_lineno the same way, including the corner cases
+//  of the flex rules: {FLOAT} takes any character as its point, comment
+//  nesting is not reset by an unterminated comment, and the start state
+//  carries over into the next file.
+//
+//  Whitespace, comments, string bodies and identifiers are skipped a
+//  whole vector at a time.  Each input byte is compared against the bytes
+//  that can end the current run, the comparisons are collapsed into a bit
+//  mask, and the lowest set bit is where scanning picks up again.  AVX2 is
+//  used when the processor has it, SSE2 otherwise, and plain loops on
+//  machines that have neither.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "seal-parse.h"
+#include "stringtab.h"
+#include "utilities.h"
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+extern FILE *fin;
+extern int curr_lineno;
+extern YYSTYPE seal_yylval;
+
+extern unsigned long long hex_value(const char *hex, size_t len);
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Byte classification
+//
+//  Every routine stops at end at the latest.  The input is followed by
+//  PADDING zero bytes, so a vector load starting before end never reads
+//  past the buffer, and zero is in none of the classes.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#define PADDING 64
+
+struct ScanOps {
+  // skip blanks and newlines, counting the newlines into lines
+  const char *(*skip_blanks)(const char *p, const char *end, int &lines);
+  // skip the rest of an identifier, [a-zA-Z0-9_]*
+  const char *(*skip_ident)(const char *p, const char *end);
+  // find the first of a, b or c, counting the newlines before it
+  const char *(*find)(const char *p, const char *end, char a, char b, char c, int &lines);
+};
+
+static bool is_ident_char(char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+static const char *scalar_skip_blanks(const char *p, const char *end, int &lines)
+{
+  for (; p < end; p++) {
+    if (*p == '\n')
+      lines++;
+    else if (*p != ' ' && *p != '\t')
+      break;
+  }
+  return p;
+}
+
+static const char *scalar_skip_ident(const char *p, const char *end)
+{
+  while (p < end && is_ident_char(*p))
+    p++;
+  return p;
+}
+
+static const char *scalar_find(const char *p, const char *end, char a, char b, char c, int &lines)
+{
+  for (; p < end; p++) {
+    if (*p == a || *p == b || *p == c)
+      break;
+    if (*p == '\n')
+      lines++;
+  }
+  return p;
+}
+
+static const ScanOps SCALAR_OPS = {scalar_skip_blanks, scalar_skip_ident, scalar_find};
+
+#ifdef __x86_64__
+
+//
+// A byte x lies in [lo, lo + n) when x - lo, taken unsigned, is below n.
+// SSE only compares signed bytes, so both sides are shifted by 128.
+//
+
+static inline __m128i sse2_in_range(__m128i v, char lo, int n)
+{
+  __m128i t = _mm_add_epi8(v, _mm_set1_epi8((char) (128 - lo)));
+  return _mm_cmpgt_epi8(_mm_set1_epi8((char) (n - 128)), t);
+}
+
+static const char *sse2_skip_blanks(const char *p, const char *end, int &lines)
+{
+  const __m128i sp = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'), nl = _mm_set1_epi8('\n');
+  for (; p < end; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *) p);
+    unsigned newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+    unsigned blanks = newlines |
+      _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab)));
+    unsigned stop = ~blanks & 0xffff;
+    if (stop != 0) {
+      int i = __builtin_ctz(stop);
+      lines += __builtin_popcount(newlines & ((1u << i) - 1));
+      return p + i;
+    }
+    lines += __builtin_popcount(newlines);
+  }
+  return end;
+}
+
+static const char *sse2_skip_ident(const char *p, const char *end)
+{
+  const __m128i lower = _mm_set1_epi8(0x20), under = _mm_set1_epi8('_');
+  for (; p < end; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *) p);
+    __m128i letter = sse2_in_range(_mm_or_si128(v, lower), 'a', 26);
+    __m128i digit = sse2_in_range(v, '0', 10);
+    __m128i ident = _mm_or_si128(_mm_or_si128(letter, digit), _mm_cmpeq_epi8(v, under));
+    unsigned stop = ~_mm_movemask_epi8(ident) & 0xffff;
+    if (stop != 0)
+      return p + __builtin_ctz(stop);
+  }
+  return end;
+}
+
+static const char *sse2_find(const char *p, const char *end, char a, char b, char c, int &lines)
+{
+  const __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b), vc = _mm_set1_epi8(c);
+  const __m128i nl = _mm_set1_epi8('\n');
+  for (; p < end; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *) p);
+    unsigned newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+    unsigned stop = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, va),
+                                                                _mm_cmpeq_epi8(v, vb)),
+                                                   _mm_cmpeq_epi8(v, vc)));
+    if (stop != 0) {
+      int i = __builtin_ctz(stop);
+      lines += __builtin_popcount(newlines & ((1u << i) - 1));
+      return p + i < end ? p + i : end;
+    }
+    lines += __builtin_popcount(newlines);
+  }
+  return end;
+}
+
+static const ScanOps SSE2_OPS = {sse2_skip_blanks, sse2_skip_ident, sse2_find};
+
+#define AVX2 __attribute__((target("avx2")))
+
+static inline AVX2 __m256i avx2_in_range(__m256i v, char lo, int n)
+{
+  __m256i t = _mm256_add_epi8(v, _mm256_set1_epi8((char) (128 - lo)));
+  return _mm256_cmpgt_epi8(_mm256_set1_epi8((char) (n - 128)), t);
+}
+
+static AVX2 const char *avx2_skip_blanks(const char *p, const char *end, int &lines)
+{
+  const __m256i sp = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t');
+  const __m256i nl = _mm256_set1_epi8('\n');
+  for (; p < end; p += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *) p);
+    unsigned newlines = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+    unsigned blanks = newlines |
+      _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, sp), _mm256_cmpeq_epi8(v, tab)));
+    unsigned stop = ~blanks;
+    if (stop != 0) {
+      int i = __builtin_ctz(stop);
+      lines += __builtin_popcount(newlines & ((1u << i) - 1));
+      return p + i;
+    }
+    lines += __builtin_popcount(newlines);
+  }
+  return end;
+}
+
+static AVX2 const char *avx2_skip_ident(const char *p, const char *end)
+{
+  const __m256i lower = _mm256_set1_epi8(0x20), under = _mm256_set1_epi8('_');
+  for (; p < end; p += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *) p);
+    __m256i letter = avx2_in_range(_mm256_or_si256(v, lower), 'a', 26);
+    __m256i digit = avx2_in_range(v, '0', 10);
+    __m256i ident = _mm256_or_si256(_mm256_or_si256(letter, digit), _mm256_cmpeq_epi8(v, under));
+    unsigned stop = ~(unsigned) _mm256_movemask_epi8(ident);
+    if (stop != 0)
+      return p + __builtin_ctz(stop);
+  }
+  return end;
+}
+
+static AVX2 const char *avx2_find(const char *p, const char *end, char a, char b, char c, int &lines)
+{
+  const __m256i va = _mm256_set1_epi8(a), vb = _mm256_set1_epi8(b), vc = _mm256_set1_epi8(c);
+  const __m256i nl = _mm256_set1_epi8('\n');
+  for (; p < end; p += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *) p);
+    unsigned newlines = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+    unsigned stop = _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, va),
+                                                                         _mm256_cmpeq_epi8(v, vb)),
+                                                         _mm256_cmpeq_epi8(v, vc)));
+    if (stop != 0) {
+      int i = __builtin_ctz(stop);
+      lines += __builtin_popcount(newlines & ((1u << i) - 1));
+      return p + i < end ? p + i : end;
+    }
+    lines += __builtin_popcount(newlines);
+  }
+  return end;
+}
+
+static const ScanOps AVX2_OPS = {avx2_skip_blanks, avx2_skip_ident, avx2_find};
+
+#endif
+
+static const ScanOps *choose_ops()
+{
+#ifdef __x86_64__
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return &AVX2_OPS;
+  return &SSE2_OPS;
+#else
+  return &SCALAR_OPS;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Input
+//
+//  A regular file is mapped over a zero-filled anonymous region that is
+//  PADDING bytes longer, anything else is read into memory.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+static FILE *scanned_file = NULL;
+static char *mapped_base = NULL;
+static size_t mapped_size = 0;
+static std::vector<char> read_text;
+static const char *cur, *text_end;
+static const ScanOps *ops = NULL;
+
+static void load(FILE *f)
+{
+  if (mapped_base != NULL) {
+    munmap(mapped_base, mapped_size);
+    mapped_base = NULL;
+  }
+  read_text.clear();
+
+  struct stat st;
+  if (fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    size_t len = st.st_size;
+    mapped_size = len + PADDING;
+    void *base = mmap(NULL, mapped_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base != MAP_FAILED &&
+        mmap(base, len, PROT_READ, MAP_PRIVATE | MAP_FIXED, fileno(f), 0) != MAP_FAILED) {
+      mapped_base = (char *) base;
+      cur = mapped_base;
+      text_end = mapped_base + len;
+      return;
+    }
+    if (base != MAP_FAILED)
+      munmap(base, mapped_size);
+  }
+
+  char chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+    read_text.insert(read_text.end(), chunk, chunk + n);
+  size_t len = read_text.size();
+  read_text.resize(len + PADDING, 0);
+  cur = &read_text[0];
+  text_end = cur + len;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Tokens
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// the start states of seal.flex that can outlive a call
+enum ScanState { SCAN_INITIAL, SCAN_COMMENT1, SCAN_STRING1 };
+
+static ScanState state = SCAN_INITIAL;
+static int comment_level = 0;
+static bool string_error = false;     // flag in seal.flex
+static std::string string_const;
+static std::string error_buf;
+
+static const struct {
+  const char *name;
+  int token;
+} KEYWORDS[] = {
+  {"if", IF}, {"else", ELSE}, {"while", WHILE}, {"for", FOR}, {"break", BREAK},
+  {"continue", CONTINUE}, {"func", FUNC}, {"return", RETURN}, {"var", VAR},
+  {"struct", STRUCT},
+};
+
+static const char *TYPES[] = {"Float", "Int", "Bool", "String", "Void"};
+
+static bool is_word(const char *p, int len, const char *word)
+{
+  return (int) strlen(word) == len && memcmp(p, word, len) == 0;
+}
+
+static bool is_digit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+static int digits(const char *p)
+{
+  const char *q = p;
+  while (q < text_end && is_digit(*q))
+    q++;
+  return q - p;
+}
+
+static int hex_digits(const char *p)
+{
+  const char *q = p;
+  while (q < text_end && (is_digit(*q) || (*q >= 'a' && *q <= 'f') || (*q >= 'A' && *q <= 'F')))
+    q++;
+  return q - p;
+}
+
+//
+// {NUMBER}, {HEX} and {FLOAT}, longest match first and the earlier rule on
+// a tie.  The point of {FLOAT} is flex's "." so any character but a newline
+// will do.
+//
+static int scan_number()
+{
+  const char *p = cur;
+  int number = p[0] == '0' ? 1 : digits(p);
+  int hex = 0, real = 0;
+  if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && p + 2 < text_end)
+    if (int h = hex_digits(p + 2))
+      hex = 2 + h;
+  if (p + number < text_end && p[number] != '\n')
+    if (int f = digits(p + number + 1))
+      real = number + 1 + f;
+
+  if (hex >= real && hex > number) {
+    cur += hex;
+    seal_yylval.symbol = inttable.add_int(hex_value(p, hex));
+    return CONST_INT;
+  }
+  if (real > number) {
+    cur += real;
+    seal_yylval.symbol = floattable.add_string((char *) p, real);
+    return CONST_FLOAT;
+  }
+  cur += number;
+  seal_yylval.symbol = inttable.add_string((char *) p, number);
+  return CONST_INT;
+}
+
+static int scan_identifier()
+{
+  const char *p = cur;
+  cur = ops->skip_ident(p + 1, text_end);
+  int len = cur - p;
+
+  if (*p >= 'a' && *p <= 'z') {
+    for (size_t k = 0; k < sizeof(KEYWORDS) / sizeof(KEYWORDS[0]); k++)
+      if (is_word(p, len, KEYWORDS[k].name))
+        return KEYWORDS[k].token;
+    if (is_word(p, len, "true") || is_word(p, len, "false")) {
+      seal_yylval.boolean = *p == 't';
+      return CONST_BOOL;
+    }
+    seal_yylval.symbol = idtable.add_string((char *) p, len);
+    return OBJECTID;
+  }
+
+  for (size_t t = 0; t < sizeof(TYPES) / sizeof(TYPES[0]); t++)
+    if (is_word(p, len, TYPES[t])) {
+      seal_yylval.symbol = idtable.add_string((char *) p, len);
+      return TYPEID;
+    }
+  error_buf = "illegal TYPEID ";
+  error_buf.append(p, len);
+  seal_yylval.error_msg = (char *) error_buf.c_str();
+  return ERROR;
+}
+
+//
+// The body of a "..." string after the opening quote.  Returns 0 when the
+// string ends without producing a token because it contained \0.
+//
+static int scan_string1()
+{
+  for (;;) {
+    const char *p = ops->find(cur, text_end, '\\', '"', '\n', curr_lineno);
+    string_const.append(cur, p - cur);
+    cur = p;
+    if (p == text_end) {
+      seal_yylval.error_msg = "EOF in string constant";
+      state = SCAN_INITIAL;
+      return ERROR;
+    }
+    if (*p == '"') {
+      cur++;
+      state = SCAN_INITIAL;
+      if (string_error)
+        return 0;
+      seal_yylval.symbol = stringtable.add_string((char *) string_const.data(), string_const.size());
+      return CONST_STRING;
+    }
+    if (*p == '\n') {
+      cur++;
+      seal_yylval.error_msg = "newline in quotation must use a '\\'";
+      state = SCAN_INITIAL;
+      ++curr_lineno;
+      return ERROR;
+    }
+
+    // a backslash
+    if (p + 1 == text_end) {
+      cur++;
+      continue;
+    }
+    cur += 2;
+    switch (p[1]) {
+    case '\n': ++curr_lineno; string_const += '\n'; break;
+    case 't': string_const += '\t'; break;
+    case 'b': string_const += '\b'; break;
+    case 'f': string_const += '\f'; break;
+    case '0':
+      seal_yylval.error_msg = "String contains null character '\\0'";
+      string_error = true;
+      return ERROR;
+    case 'n': string_const += '\n'; break;
+    default: string_const += p[1];
+    }
+  }
+}
+
+static int scan_string2()
+{
+  const char *p = ops->find(cur + 1, text_end, '`', '`', '`', curr_lineno);
+  if (p == text_end) {
+    cur = text_end;
+    seal_yylval.error_msg = "EOF in string constant";
+    return ERROR;
+  }
+  seal_yylval.symbol = stringtable.add_string((char *) cur + 1, p - cur - 1);
+  cur = p + 1;
+  return CONST_STRING;
+}
+
+// a /* comment, nested ones included; ERROR if it runs into the end
+static int skip_comment2()
+{
+  comment_level++;
+  cur += 2;
+  for (;;) {
+    cur = ops->find(cur, text_end, '/', '*', '*', curr_lineno);
+    if (cur == text_end) {
+      seal_yylval.error_msg = "EOF in comment constant";
+      return ERROR;
+    }
+    if (cur[0] == '/' && cur[1] == '*') {
+      comment_level++;
+      cur += 2;
+    } else if (cur[0] == '*' && cur[1] == '/') {
+      cur += 2;
+      if (--comment_level == 0)
+        return 0;
+    } else {
+      cur++;
+    }
+  }
+}
+
+// the rest of a // comment; false if the file ends first
+static bool skip_comment1()
+{
+  int lines = 0;
+  cur = ops->find(cur, text_end, '\n', '\n', '\n', lines);
+  if (cur == text_end)
+    return false;
+  cur++;
+  curr_lineno++;
+  state = SCAN_INITIAL;
+  return true;
+}
+
+static int scan_operator()
+{
+  const char *p = cur++;
+  char c = p[0], next = p + 1 < text_end ? p[1] : 0;
+  switch (c) {
+  case '=': if (next == '=') { cur++; return EQUAL; } break;
+  case '!': if (next == '=') { cur++; return NE; } break;
+  case '>': if (next == '=') { cur++; return GE; } break;
+  case '<': if (next == '=') { cur++; return LE; } break;
+  case '&': if (next == '&') { cur++; return AND; } break;
+  case '|': if (next == '|') { cur++; return OR; } break;
+  case '*':
+    if (next == '/') {
+      cur++;
+      seal_yylval.error_msg = "Unmatched */";
+      return ERROR;
+    }
+    break;
+  case '+': case '-': case '/': case '^': case '%': case ';': case '~':
+  case '{': case '}': case '(': case ')': case ':': case ',':
+    break;
+  default:
+    error_buf.assign(1, c);
+    seal_yylval.error_msg = (char *) error_buf.c_str();
+    return ERROR;
+  }
+  return c;
+}
+
+//
+// Called through seal_yylex_hook, which seal.flex checks on every call.
+//
+int seal_scan_yylex()
+{
+  if (ops == NULL)
+    ops = choose_ops();
+  if (fin != scanned_file) {
+    scanned_file = fin;
+    load(fin);
+  }
+
+  for (;;) {
+    if (state == SCAN_COMMENT1 && !skip_comment1())
+      break;
+    if (state == SCAN_STRING1) {
+      if (int token = scan_string1())
+        return token;
+      continue;
+    }
+
+    cur = ops->skip_blanks(cur, text_end, curr_lineno);
+    if (cur == text_end)
+      break;
+
+    char c = *cur;
+    if (is_digit(c))
+      return scan_number();
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_')
+      return scan_identifier();
+    if (c == '"') {
+      cur++;
+      string_const.clear();
+      string_error = false;
+      state = SCAN_STRING1;
+      continue;
+    }
+    if (c == '`')
+      return scan_string2();
+    if (c == '/' && cur + 1 < text_end && cur[1] == '/') {
+      cur += 2;
+      state = SCAN_COMMENT1;
+      continue;
+    }
+    if (c == '/' && cur + 1 < text_end && cur[1] == '*') {
+      if (int token = skip_comment2())
+        return token;
+      continue;
+    }
+    return scan_operator();
+  }
+
+  // the FILE of the next input may well be the one just closed
+  scanned_file = NULL;
+  return 0;
+}
@@ -25,6 +25,7 @@ protected:
    Symbol name;
    Symbol type;
 public:
+   Binding binding;                  // set by semant
    Variable_class(Symbol a1, Symbol a2) {
       name = a1;
       type = a2;
@@ -47,6 +48,7 @@ public:
    }
    Symbol getName() { return variable->getName(); }
    Symbol getType() { return variable->getType(); }
+   Variable getVariable() { return variable; }
 
    Decl copy_Decl();
    void check();
@@ -16,12 +16,14 @@ typedef class Call_class *Call;
 class Expr_class : public Stmt_class {
 public:     
    Symbol type;                      
+   TypeKind kind;                    // type as an enum, kept in step by setType
    Symbol getType() { return type; }           
-   Expr setType(Symbol s) { type = s; return this; } 
+   TypeKind getKind() { return kind; }
+   Expr setType(Symbol s) { type = s; kind = type_kind(s); return this; } 
    Stmt copy_Stmt() { return copy_Expr(); }             
-   Expr_class() { type = (Symbol) NULL; }
+   Expr_class() { type = (Symbol) NULL; kind = TYPE_NONE; }
    Expr_class(Symbol a1) {
-        type = a1;
+        setType(a1);
    }
    void check(Symbol a) {checkType();}
    void dump_type(ostream&, int);
@@ -33,6 +35,14 @@ public:
 	virtual void dump(ostream&,int) = 0;
    virtual Expr copy_Expr() = 0;
    virtual Symbol checkType() = 0;
+   // constant folding under -O, returns the expression to use in place of this one
+   virtual Expr fold() = 0;
+   // the value of a constant, false if this is not one
+   virtual bool int_value(long long &) { return false; }
+   virtual bool float_value(double &) { return false; }
+   virtual bool bool_value(bool &) { return false; }
+   // evaluating it has no effect, so folding may drop it
+   virtual bool is_pure() { return false; }
    virtual bool is_empty_Expr() = 0;
 };
 
@@ -53,6 +63,7 @@ public:
 	void dump(ostream&,int);
    void dump_type(ostream& , int );
    Symbol checkType();
+   Expr fold();
 };
 
 
@@ -69,6 +80,7 @@ public:
 	void dump(ostream&,int);
    void dump_type(ostream& , int );
    Symbol checkType();
+   Expr fold();
 };
 
 // define constructor - expr
@@ -77,6 +89,7 @@ protected:
    Symbol lvalue;
    Expr value;
 public:
+   Binding binding;                  // the variable assigned, set by semant
    Assign_class(Symbol a1, Expr a2)  {
       lvalue = a1;
       value = a2;
@@ -86,6 +99,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 // define constructor - add
@@ -103,6 +117,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 // define constructor - minus
@@ -120,6 +135,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 // define constructor - multi
@@ -136,7 +152,8 @@ public:
    Expr copy_Expr();
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int);
-   Symbol checkType(); 
+   Symbol checkType();
+   Expr fold();
 };
 
 // define constructor - divide
@@ -154,6 +171,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 // define constructor - mod
@@ -171,6 +189,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 // define constructor - -
@@ -186,6 +205,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 // define constructor - <
@@ -203,6 +223,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 // define constructor - <=
@@ -220,6 +241,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 // define constructor - ==
@@ -237,6 +259,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 // define constructor - !=
@@ -254,6 +277,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 // define constructor - >=
@@ -271,6 +295,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 // define constructor - >
@@ -288,6 +313,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 // define constructor - and &&
@@ -305,6 +331,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 // define constructor - or ||
@@ -322,6 +349,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 // define constructor - xor ^
@@ -339,6 +367,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 // define constructor - not !
@@ -354,6 +383,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 // define constructor - bitnot ~
@@ -369,6 +399,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 class Bitand_class : public Expr_class {
@@ -385,6 +416,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 class Bitor_class : public Expr_class {
@@ -401,6 +433,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 // define constructconst_int - const_int
@@ -416,6 +449,9 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
+   bool int_value(long long &v) { v = ((IntEntryP) value)->get_value(); return true; }
+   bool is_pure() { return true; }
 };
 
 // define constructconst_string - const_string
@@ -431,6 +467,8 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
+   bool is_pure() { return true; }
 };
 
 // define constructconst_float - const_float
@@ -446,6 +484,9 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
+   bool float_value(double &v) { v = ((FloatEntryP) value)->get_value(); return true; }
+   bool is_pure() { return true; }
 };
 
 // define constructconst_bool - const_bool
@@ -461,12 +502,16 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
+   bool bool_value(bool &v) { v = value; return true; }
+   bool is_pure() { return true; }
 };
 
 class Object_class : public Expr_class {
 protected:
    Symbol var;
 public:
+   Binding binding;                  // the variable read, set by semant
    Object_class(Symbol a1) {
       var = a1;
    }
@@ -476,6 +521,8 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
+   bool is_pure() { return true; }
 };
 
 // define constructor - no_expr
@@ -489,6 +536,7 @@ public:
    void dump(ostream& stream, int n);
    void dump_with_types(ostream&,int); 
    Symbol checkType();
+   Expr fold();
 };
 
 
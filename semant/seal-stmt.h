@@ -30,6 +30,7 @@ public:
 	virtual void dump_with_types(ostream&,int) = 0; 
 	virtual void dump(ostream&,int) = 0;
 	virtual void check(Symbol) = 0;
+	virtual Stmt fold() = 0;
 	virtual bool isReturn() = 0;
 	virtual bool isBreak() = 0;
 	virtual bool isContinue() = 0;
@@ -50,6 +51,7 @@ public:
 	VariableDecls getVariableDecls(){return vars;};
 	StmtBlock copy_StmtBlock();
 	void check(Symbol);
+	Stmt fold();
 	void dump(ostream& , int );
 	void dump_with_types(ostream&,int);
 	bool isReturn() {
@@ -97,6 +99,7 @@ public:
 	StmtBlock getElse(){return elseexpr;}
     Stmt copy_Stmt();
 	void check(Symbol);
+	Stmt fold();
 	void dump(ostream& stream, int n);
 	void dump_with_types(ostream&,int);
 	bool isReturn(){return false;}
@@ -120,6 +123,7 @@ public:
 	StmtBlock getBody(){return body;}
     Stmt copy_Stmt();
 	void check(Symbol);
+	Stmt fold();
 	void dump(ostream& stream, int n);
 	void dump_with_types(ostream&,int);
 	bool isReturn(){return false;}
@@ -143,6 +147,7 @@ public:
 	Expr getLoop(){return loopact;}
 	StmtBlock getBody(){return body;}
 	void check(Symbol);
+	Stmt fold();
     Stmt copy_Stmt();
 	void dump(ostream& stream, int n);
 	void dump_with_types(ostream&,int);
@@ -163,6 +168,7 @@ public:
 	Expr getValue(){return value;}
     Stmt copy_Stmt();
 	void check(Symbol);
+	Stmt fold();
     void dump_with_types(ostream&,int);
     void dump(ostream& stream, int n);
 	bool isReturn(){return true;}
@@ -175,6 +181,7 @@ public:
 	ContinueStmt_class() {}
     Stmt copy_Stmt();
 	void check(Symbol);
+	Stmt fold();
     void dump_with_types(ostream&,int);
     void dump(ostream& stream, int n);
 	bool isReturn(){return false;}
@@ -188,6 +195,7 @@ public:
 	BreakStmt_class() {}
     Stmt copy_Stmt();
 	void check(Symbol);
+	Stmt fold();
     void dump_with_types(ostream&,int);
     void dump(ostream& stream, int n);
 	bool isReturn(){return false;}
@@ -20,6 +20,30 @@ void dump_Symbol(ostream& stream, int padding, Symbol b);
 void assert_Symbol(Symbol b);
 Symbol copy_Symbol(Symbol b);
 
+//
+// The basic types as a small enum.  setType caches one on every
+// expression, so type dispatch is a switch rather than comparisons
+// against the type Symbols.  type_kind is defined in semant.cc next to
+// the Symbols it maps.
+//
+enum TypeKind { TYPE_NONE, TYPE_INT, TYPE_FLOAT, TYPE_BOOL, TYPE_STRING, TYPE_VOID };
+TypeKind type_kind(Symbol type);
+
+//
+// Where a variable name resolves to.  Semant fills one in for every
+// variable and every use of one, so the code generator never looks a
+// name up again.  index is the position of a para, the slot of a local
+// within its function, or the number of a global.
+//
+struct Binding {
+  enum Kind { UNBOUND, PARA, LOCAL, STATIC };
+  Kind kind;
+  int index;
+  Symbol name;
+  Binding() : kind(UNBOUND), index(-1), name(NULL) {}
+  Binding(Kind k, int i, Symbol n) : kind(k), index(i), name(n) {}
+};
+
 class Program_class;
 typedef Program_class *Program;
 class Decl_class;
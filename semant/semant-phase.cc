@@ -10,6 +10,7 @@ FILE *fin;                    // input file
 extern int optind;  // used for option processing (man 3 getopt for more info)
 extern int seal_yyparse(void); // entry point to the AST parser
 extern int omerrs;            // syntax check errors
+extern int semant_debug;      // -s, also reports the tree arena
 char *curr_filename;
 
 void handle_flags(int argc, char *argv[]);
@@ -28,6 +29,9 @@ int main(int argc, char *argv[]) {
   }
   ast_root->semant();
   ast_root->dump_with_types(cout,0);
+  if (semant_debug)
+    tree_arena.stats(cerr);
+  tree_arena.release();
   fclose(fin);
 }
 
@@ -1,31 +1,33 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <limits.h>
+#include <math.h>
 #include "semant.h"
 #include "utilities.h"
 #include <map>
 #include <vector>
 
 extern int semant_debug;
+extern int cgen_optimize;
 extern char *curr_filename;
 
 static ostream& error_stream = cerr;
-static int semant_errors = 0;
+int semant_errors = 0;
 static Decl curr_decl = 0;
 
-typedef SymbolTable<Symbol, Symbol> ObjectEnvironment; // name, type
+typedef SymbolTable<Symbol, Variable_class> ObjectEnvironment; // name, para or local
 ObjectEnvironment objectEnv;
 
 typedef std::map<Symbol, Symbol> CallTable;
 CallTable callTable;
 
-// globalVars stores global variables' name and type
-typedef std::map<Symbol, Symbol> GlobalVariables;
+// globalVars stores global variables' name and declaration
+typedef std::map<Symbol, Variable> GlobalVariables;
 GlobalVariables globalVars;
 
-// localVars stores local variables' name and type
-typedef std::map<Symbol, Symbol> LocalVariables;
-LocalVariables localVars;
+// locals of the function being checked, numbered in declaration order
+static int local_slots = 0;
 
 // MethodClass stores para type
 // MethodTable stores name and related paras
@@ -57,6 +59,16 @@ static ostream& internal_error(int lineno) {
     return error_stream;
 }
 
+// a visible variable: locals and paras shadow globals, NULL if undefined
+static Variable lookup_var(Symbol name) {
+    Variable local = objectEnv.lookup(name);
+    if (local != NULL) {
+        return local;
+    }
+    GlobalVariables::iterator it = globalVars.find(name);
+    return it == globalVars.end() ? NULL : it->second;
+}
+
 //////////////////////////////////////////////////////////////////////
 //
 // Symbols
@@ -110,8 +122,40 @@ static void initialize_constants(void) {
     Of course, you can add any other functions to help.
 */
 
-static bool sameType(Symbol name1, Symbol name2) {
-    return strcmp(name1->get_string(), name2->get_string()) == 0;
+TypeKind type_kind(Symbol type) {
+    if (type == Int) return TYPE_INT;
+    if (type == Float) return TYPE_FLOAT;
+    if (type == Bool) return TYPE_BOOL;
+    if (type == String) return TYPE_STRING;
+    if (type == Void) return TYPE_VOID;
+    return TYPE_NONE;
+}
+
+// both kinds of an operator's operands in one switch label
+#define TYPE_PAIR(l, r) ((l) << 3 | (r))
+
+static bool is_number(Expr e) {
+    switch (e->getKind()) {
+    case TYPE_INT:
+    case TYPE_FLOAT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Int and Float operands mix into a Float result, other operands have to
+// be of the same type; false if they are not
+static bool arith_type(Expr e1, Expr e2, Symbol &result) {
+    switch (TYPE_PAIR(e1->getKind(), e2->getKind())) {
+    case TYPE_PAIR(TYPE_INT, TYPE_FLOAT):
+    case TYPE_PAIR(TYPE_FLOAT, TYPE_INT):
+        result = Float;
+        return true;
+    default:
+        result = e1->getType();
+        return e1->getType() == e2->getType();
+    }
 }
 
 static void install_calls(Decls decls) {
@@ -121,7 +165,7 @@ static void install_calls(Decls decls) {
         if (decls->nth(i)->isCallDecl()) {
             if (callTable[name] != NULL) {
                 semant_error(decls->nth(i))<<"Function "<<name<<" was previously defined."<<endl;
-            } else if (type != Int && type != Void && type != String && type != Float && type != Bool) {
+            } else if (type_kind(type) == TYPE_NONE) {
                 semant_error(decls->nth(i))<<"Function returnType error."<<endl;
             } else if (!isValidCallName(name)) {
                 semant_error(decls->nth(i))<<"Function printf cannot have a name as printf"<<endl;
@@ -134,6 +178,7 @@ static void install_calls(Decls decls) {
 }
 
 static void install_globalVars(Decls decls) {
+    int number = 0;
     for (int i=decls->first(); decls->more(i); i=decls->next(i)) {
         Symbol name = decls->nth(i)->getName();
         Symbol type = decls->nth(i)->getType();
@@ -145,7 +190,9 @@ static void install_globalVars(Decls decls) {
             } else if (name == print) {
                 semant_error(decls->nth(i))<<"Variable printf cannot have a name as printf"<<endl;
             }
-            globalVars[name] = type;
+            Variable var = ((VariableDecl) decls->nth(i))->getVariable();
+            var->binding = Binding(Binding::STATIC, number++, name);
+            globalVars[name] = var;
         }
     }
 }
@@ -154,7 +201,6 @@ static void check_calls(Decls decls) {
     objectEnv.enterscope();
     for (int i=decls->first(); decls->more(i); i=decls->next(i)) {
         if (decls->nth(i)->isCallDecl()) {
-            localVars.clear();
             decls->nth(i)->check();
         }
     }
@@ -173,8 +219,9 @@ void VariableDecl_class::check() {
     if (type == Void) {
         semant_error()<<"var "<<name<<" cannot be of type Void. Void can just be used as return type."<<endl;
     } else {
-        objectEnv.addid(name, new Symbol(type));
-        localVars[name] = type;
+        Variable var = this->getVariable();
+        var->binding = Binding(Binding::LOCAL, local_slots++, name);
+        objectEnv.addid(name, var);
     }
 }
 
@@ -199,8 +246,7 @@ void CallDecl_class::check() {
             if (objectEnv.lookup(name) != NULL) {
                 semant_error(this)<<"Function "<<funcName<< "'s parameter has a duplicate name "<<name<<endl;
             }
-            objectEnv.addid(name, &type);
-            localVars[name] = type;
+            objectEnv.addid(name, vars->nth(j));
             mclass.push_back(type);
         }
 
@@ -208,9 +254,10 @@ void CallDecl_class::check() {
         methodTable[funcName] = mclass;
         installTable[name] = true;
     } else {
+        local_slots = 0;
+        int position = 0;
         for (int j=vars->first(); vars->more(j); j=vars->next(j)) {
             Symbol name = vars->nth(j)->getName();
-            Symbol type = vars->nth(j)->getType();
             
             /* No need to check paras' type because of syntax rules */
 
@@ -218,8 +265,8 @@ void CallDecl_class::check() {
             if (objectEnv.lookup(name) != NULL) {
                 semant_error(this)<<"Function "<<funcName<< "'s parameter has a duplicate name "<<name<<endl;
             }
-            objectEnv.addid(name, new Symbol (type));
-            localVars[name] = type;
+            vars->nth(j)->binding = Binding(Binding::PARA, position++, name);
+            objectEnv.addid(name, vars->nth(j));
         }
         // main function should not have any paras
         if (funcName == Main && vars->len() != 0) {
@@ -228,14 +275,7 @@ void CallDecl_class::check() {
             semant_error(this)<<"main function should have return type Void."<<endl;
         }
 
-        // check stmtBlock
-        // 1. check variableDecls
-        VariableDecls varDecls = stmtblock->getVariableDecls();
-        for (int j=varDecls->first(); varDecls->more(j); j=varDecls->next(j)) {
-            varDecls->nth(j)->check();
-        }
-
-        // 2. check stmts
+        // check stmtBlock, its variableDecls are installed in a scope of their own
         stmtblock->check(returnType);
         if (!stmtblock->isReturn()) {
             semant_error(this)<<"Function "<<name<<" must have an overall return statement."<<endl;
@@ -262,10 +302,16 @@ void CallDecl_class::check() {
 }
 
 void StmtBlock_class::check(Symbol type) {
+    VariableDecls varDecls = this->getVariableDecls();
     Stmts stmts = this->getStmts(); 
+    objectEnv.enterscope();
+    for (int j=varDecls->first(); varDecls->more(j); j=varDecls->next(j)) {
+        varDecls->nth(j)->check();
+    }
     for (int j=stmts->first(); stmts->more(j); j=stmts->next(j)) {
         stmts->nth(j)->check(type);
     }
+    objectEnv.exitscope();
 }
 
 void IfStmt_class::check(Symbol type) {
@@ -275,7 +321,7 @@ void IfStmt_class::check(Symbol type) {
     
     // If condition should be Bool
     Symbol conditionType = condition->checkType();
-    if (conditionType != Bool) {
+    if (condition->getKind() != TYPE_BOOL) {
         semant_error(this)<<"condition type should be Bool, but found"<<conditionType<<endl;
     }
 
@@ -290,7 +336,7 @@ void WhileStmt_class::check(Symbol type) {
 
     // While condition should be Bool
     Symbol conditionType = condition->checkType();
-    if (conditionType != Bool) {
+    if (condition->getKind() != TYPE_BOOL) {
         semant_error(this)<<"condition type should be Bool, but found"<<conditionType<<endl;
     }
 
@@ -308,7 +354,7 @@ void ForStmt_class::check(Symbol type) {
     loop->checkType();
     // For condition should be Bool
     Symbol conditionType = condition->checkType();
-    if (conditionType != Bool) {
+    if (condition->getKind() != TYPE_BOOL) {
         semant_error(this)<<"condition type should be Bool, but found"<<conditionType<<endl;
     }
 
@@ -321,7 +367,7 @@ void ReturnStmt_class::check(Symbol type) {
     
     // check if return Type match
     Symbol returnType = expr->checkType();
-    if (returnType != Void) {
+    if (expr->getKind() != TYPE_VOID) {
         if (expr->is_empty_Expr() && type != Void) {
             semant_error(this)<<"Returns Void, but need "<<type<<endl;
         } else if (!expr->is_empty_Expr() && type != returnType) {
@@ -349,8 +395,12 @@ Symbol Call_class::checkType(){
             this->setType(Void);
             return type;
         }
-        Symbol sym = actuals->nth(actuals->first())->checkType();
-        if (sym != String) {
+        Actual format = actuals->nth(actuals->first());
+        format->checkType();
+        for (int i=actuals->next(actuals->first()); actuals->more(i); i=actuals->next(i)) {
+            actuals->nth(i)->checkType();
+        }
+        if (format->getKind() != TYPE_STRING) {
             semant_error(this)<<"printf()'s first parameter must be of type String."<<endl;
             this->setType(Void);
             return type;
@@ -391,10 +441,14 @@ Symbol Actual_class::checkType(){
 }
 
 Symbol Assign_class::checkType(){
-    if (objectEnv.lookup(lvalue) == NULL && globalVars[lvalue] == NULL) {
+    Variable var = lookup_var(lvalue);
+    Symbol ls = NULL;
+    if (var == NULL) {
         semant_error(this)<<"Undefined value"<<endl;
-    } 
-    Symbol ls = localVars[lvalue];
+    } else {
+        ls = var->getType();
+        binding = var->binding;
+    }
     Symbol rs = value->checkType();
     if (ls != rs) {
         semant_error(this)<<"assign value mismatch"<<endl;
@@ -404,111 +458,80 @@ Symbol Assign_class::checkType(){
 }
 
 Symbol Add_class::checkType(){
-    Expr lvalue = e1;
-    Expr rvalue = e2;
-    Symbol ls = lvalue->checkType();
-    Symbol rs = rvalue->checkType();
+    e1->checkType();
+    e2->checkType();
 
-    if (ls != rs && !(ls == Int && rs == Float) && !(ls == Float && rs == Int)) {
+    Symbol result;
+    if (!arith_type(e1, e2, result)) {
         semant_error(this)<<"lvalue and rvalue should have same type."<<endl;
     }
-    if ((ls == Float && rs == Int)||(ls == Int && rs == Float)) {
-        this->setType(Float);
-        return type;
-    }
-
-    this->setType(ls);
+    this->setType(result);
     return type;
 }
 
 Symbol Minus_class::checkType(){
-    Expr lvalue = e1;
-    Expr rvalue = e2;
-    Symbol ls = lvalue->checkType();
-    Symbol rs = rvalue->checkType();
+    e1->checkType();
+    e2->checkType();
 
-    if (ls != rs && !(ls == Int && rs == Float) && !(ls == Float && rs == Int)) {
+    Symbol result;
+    if (!arith_type(e1, e2, result)) {
         semant_error(this)<<"Both lvalue and rvalue should be type Int"<<endl;
     }
-    if ((ls == Float && rs == Int)||(ls == Int && rs == Float)) {
-        this->setType(Float);
-        return type;
-    }
-
-    this->setType(ls);
+    this->setType(result);
     return type;
 }
 
 Symbol Multi_class::checkType(){
-    Expr lvalue = e1;
-    Expr rvalue = e2;
-    Symbol ls = lvalue->checkType();
-    Symbol rs = rvalue->checkType();
+    e1->checkType();
+    e2->checkType();
 
-    if (ls != rs && !(ls == Int && rs == Float) && !(ls == Float && rs == Int)) {
+    Symbol result;
+    if (!arith_type(e1, e2, result)) {
         semant_error(this)<<"Both lvalue and rvalue should be type Int"<<endl;
     }
-    if ((ls == Float && rs == Int)||(ls == Int && rs == Float)) {
-        this->setType(Float);
-        return type;
-    }
-
-    this->setType(ls);
+    this->setType(result);
     return type;
 }
 
 Symbol Divide_class::checkType(){
-    Expr lvalue = e1;
-    Expr rvalue = e2;
-    Symbol ls = lvalue->checkType();
-    Symbol rs = rvalue->checkType();
+    e1->checkType();
+    e2->checkType();
 
-    if (ls != rs && !(ls == Int && rs == Float) && !(ls == Float && rs == Int)) {
+    Symbol result;
+    if (!arith_type(e1, e2, result)) {
         semant_error(this)<<"Both lvalue and rvalue should be type Int"<<endl;
     }
-    if ((ls == Float && rs == Int)||(ls == Int && rs == Float)) {
-        this->setType(Float);
-        return type;
-    }
-
-    this->setType(ls);
+    this->setType(result);
     return type;
 }
 
 Symbol Mod_class::checkType(){
-    Expr lvalue = e1;
-    Expr rvalue = e2;
-    Symbol ls = lvalue->checkType();
-    Symbol rs = rvalue->checkType();
+    e1->checkType();
+    e2->checkType();
 
-    if (ls != rs && !(ls == Int && rs == Float) && !(ls == Float && rs == Int)) {
+    Symbol result;
+    if (!arith_type(e1, e2, result)) {
         semant_error(this)<<"Both lvalue and rvalue should be type Int"<<endl;
     }
-    if ((ls == Float && rs == Int)||(ls == Int && rs == Float)) {
-        this->setType(Float);
-        return type;
-    }
-
-    this->setType(ls);
+    this->setType(result);
     return type;
 }
 
 Symbol Neg_class::checkType(){
-    Expr value = e1;
     Symbol sym = e1->checkType();
-    if (sym != Int && sym != Float) {
+    if (!is_number(e1)) {
         semant_error(this)<<"Neg_class should have Int type"<<endl;
+        this->setType(Int);
+        return type;
     }
-    this->setType(Int);
+    this->setType(sym);
     return type;
 }
 
 Symbol Lt_class::checkType(){
-    Expr lvalue = e1;
-    Expr rvalue = e2;
-    Symbol ls = e1->checkType();
-    Symbol rs = e2->checkType();
-    if ((ls != Int && ls !=Float) || (rs != Int && rs != Float)) {
+    e1->checkType();
+    e2->checkType();
+    if (!is_number(e1) || !is_number(e2)) {
         semant_error(this)<<"ltype mismatch rvalue"<<endl;
     }
     this->setType(Bool); 
@@ -516,11 +539,9 @@ Symbol Lt_class::checkType(){
 }
 
 Symbol Le_class::checkType(){
-    Expr lvalue = e1;
-    Expr rvalue = e2;
-    Symbol ls = e1->checkType();
-    Symbol rs = e2->checkType();
-    if ((ls != Int && ls !=Float) || (rs != Int && rs != Float)) {
+    e1->checkType();
+    e2->checkType();
+    if (!is_number(e1) || !is_number(e2)) {
         semant_error(this)<<"ltype mismatch rtype"<<endl;
     }
     this->setType(Bool); 
@@ -528,60 +549,52 @@ Symbol Le_class::checkType(){
 }
 
 Symbol Equ_class::checkType(){
-    Expr lvalue = e1;
-    Expr rvalue = e2;
-    Symbol ls = e1->checkType();
-    Symbol rs = e2->checkType();
-    if (((ls != Int && ls !=Float) || (rs != Int && rs != Float))&&(ls != Bool || rs != Bool)) {
+    e1->checkType();
+    e2->checkType();
+    if (!(is_number(e1) && is_number(e2)) &&
+        !(e1->getKind() == TYPE_BOOL && e2->getKind() == TYPE_BOOL)) {
         semant_error(this)<<"ltype mismatch rtype"<<endl;
-    }    
+    }
     this->setType(Bool); 
     return type;
 }
 
 Symbol Neq_class::checkType(){
-    Expr lvalue = e1;
-    Expr rvalue = e2;
-    Symbol ls = e1->checkType();
-    Symbol rs = e2->checkType();
-    if (((ls != Int && ls !=Float) || (rs != Int && rs != Float))&&(ls != Bool || rs != Bool)) {
+    e1->checkType();
+    e2->checkType();
+    if (!(is_number(e1) && is_number(e2)) &&
+        !(e1->getKind() == TYPE_BOOL && e2->getKind() == TYPE_BOOL)) {
         semant_error(this)<<"ltype mismatch rtype"<<endl;
-    }    
+    }
     this->setType(Bool); 
     return type;
 }
 
 Symbol Ge_class::checkType(){
-    Expr lvalue = e1;
-    Expr rvalue = e2;
-    Symbol ls = e1->checkType();
-    Symbol rs = e2->checkType();
-    if ((ls != Int && ls !=Float) || (rs != Int && rs != Float)) {
+    e1->checkType();
+    e2->checkType();
+    if (!is_number(e1) || !is_number(e2)) {
         semant_error(this)<<"ltype mismatch rtype"<<endl;
-    }    
+    }
     this->setType(Bool); 
     return type;
 }
 
 Symbol Gt_class::checkType(){
-    Expr lvalue = e1;
-    Expr rvalue = e2;
-    Symbol ls = e1->checkType();
-    Symbol rs = e2->checkType();
-    if ((ls != Int && ls !=Float) || (rs != Int && rs != Float)) {
+    e1->checkType();
+    e2->checkType();
+    if (!is_number(e1) || !is_number(e2)) {
         semant_error(this)<<"ltype mismatch rtype"<<endl;
-    }    
+    }
     this->setType(Bool); 
     return type;
 }
 
 Symbol And_class::checkType(){
-    Expr lvalue = e1;
-    Expr rvalue = e2;
-    Symbol ls = lvalue->checkType();
-    Symbol rs = rvalue->checkType();
+    e1->checkType();
+    e2->checkType();
 
-    if (ls != Bool || rs != Bool) {
+    if (e1->getKind() != TYPE_BOOL || e2->getKind() != TYPE_BOOL) {
         semant_error(this)<<"Both lvalue and rvalue should be type Bool"<<endl;
     }
     this->setType(Bool);
@@ -589,12 +602,10 @@ Symbol And_class::checkType(){
 }
 
 Symbol Or_class::checkType(){
-    Expr lvalue = e1;
-    Expr rvalue = e2;
-    Symbol ls = lvalue->checkType();
-    Symbol rs = rvalue->checkType();
+    e1->checkType();
+    e2->checkType();
 
-    if (ls != Bool || rs != Bool) {
+    if (e1->getKind() != TYPE_BOOL || e2->getKind() != TYPE_BOOL) {
         semant_error(this)<<"Both lvalue and rvalue should be type Bool"<<endl;
     }
     this->setType(Bool);
@@ -602,21 +613,25 @@ Symbol Or_class::checkType(){
 }
 
 Symbol Xor_class::checkType(){
-    Expr lvalue = e1;
-    Expr rvalue = e2;
-    Symbol ls = lvalue->checkType();
-    Symbol rs = rvalue->checkType();
+    Symbol ls = e1->checkType();
+    e2->checkType();
 
-    if (!(ls == Bool && rs == Bool) && !(ls == Int && rs ==Int)) {
+    switch (TYPE_PAIR(e1->getKind(), e2->getKind())) {
+    case TYPE_PAIR(TYPE_BOOL, TYPE_BOOL):
+    case TYPE_PAIR(TYPE_INT, TYPE_INT):
+        break;
+    default:
         semant_error(this)<<"Both lvalue and rvalue should be type Bool"<<endl;
+        this->setType(Bool);
+        return type;
     }
-    this->setType(Bool);
+    this->setType(ls);
     return type;
 }
 
 Symbol Not_class::checkType(){
     Symbol sym = e1->checkType();
-    if (sym != Bool) {
+    if (e1->getKind() != TYPE_BOOL) {
         semant_error(this)<<"Not class should have Bool type"<<endl;
     }
 
@@ -625,10 +640,10 @@ Symbol Not_class::checkType(){
 }
 
 Symbol Bitand_class::checkType(){
-    Symbol ls = e1->checkType();
-    Symbol rs = e2->checkType();
+    e1->checkType();
+    e2->checkType();
 
-    if (ls != Int || rs != Int) {
+    if (e1->getKind() != TYPE_INT || e2->getKind() != TYPE_INT) {
         semant_error(this)<<"Bitand class should have Int type"<<endl;
     }
 
@@ -637,10 +652,10 @@ Symbol Bitand_class::checkType(){
 }
 
 Symbol Bitor_class::checkType(){
-    Symbol ls = e1->checkType();
-    Symbol rs = e2->checkType();
+    e1->checkType();
+    e2->checkType();
 
-    if (ls != Int || rs != Int) {
+    if (e1->getKind() != TYPE_INT || e2->getKind() != TYPE_INT) {
         semant_error(this)<<"Bitor class should have Int type"<<endl;
     }
 
@@ -649,9 +664,9 @@ Symbol Bitor_class::checkType(){
 }
 
 Symbol Bitnot_class::checkType(){
-    Symbol sym = e1->checkType();
+    e1->checkType();
 
-    if (sym != Int) {
+    if (e1->getKind() != TYPE_INT) {
         semant_error(this)<<"Bitnot class should have Int type"<<endl;
     }
 
@@ -680,13 +695,14 @@ Symbol Const_bool_class::checkType(){
 }
 
 Symbol Object_class::checkType(){
-    if (objectEnv.lookup(var) == NULL) {
+    Variable v = lookup_var(var);
+    if (v == NULL) {
         semant_error(this)<<"object "<<var<<" has not been defined."<<endl;
         this->setType(Void);
         return type;
     }
-    Symbol ty = localVars[var];
-    this->setType(ty);
+    binding = v->binding;
+    this->setType(v->getType());
     return type;
 }
 
@@ -695,6 +711,461 @@ Symbol No_expr_class::checkType(){
     return getType();
 }
 
+///////////////////////////////////////////////
+// constant folding
+///////////////////////////////////////////////
+
+/*
+    Under -O the checked tree is folded before code generation.  Constant
+    operands are evaluated the way the generated code would evaluate them:
+    Int arithmetic wraps at 64 bits, Floats are IEEE doubles and Int
+    operands of a Float operation are converted first.  Anything that
+    would trap at run time is left alone.  Identities only drop an operand
+    when evaluating it has no effect.
+*/
+
+enum Arith { ARITH_ADD, ARITH_SUB, ARITH_MUL, ARITH_DIV, ARITH_MOD };
+enum Relation { REL_LT, REL_LE, REL_EQ, REL_NE, REL_GE, REL_GT };
+
+// a constant standing in for the folded expression e
+static Expr int_constant(Expr e, long long v) {
+    Expr c = const_int(inttable.add_int(v));
+    c->set(e);
+    return c->setType(Int);
+}
+
+// NaN payloads do not survive the float table, those stay at run time
+static Expr float_constant(Expr e, double v) {
+    if (v != v) {
+        return e;
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.17g", v);
+    Expr c = const_float(floattable.add_string(buf));
+    c->set(e);
+    return c->setType(Float);
+}
+
+static Expr bool_constant(Expr e, bool v) {
+    Expr c = const_bool(v);
+    c->set(e);
+    return c->setType(Bool);
+}
+
+// an Int or Float constant as a double
+static bool number_value(Expr e, double &v) {
+    long long i;
+    if (e->int_value(i)) {
+        v = (double) i;
+        return true;
+    }
+    return e->float_value(v);
+}
+
+static Expr fold_int_arith(Expr e, Arith op, Expr e1, Expr e2) {
+    long long a, b;
+    bool ca = e1->int_value(a);
+    bool cb = e2->int_value(b);
+    if (ca && cb) {
+        unsigned long long ua = a, ub = b;
+        switch (op) {
+        case ARITH_ADD:
+            return int_constant(e, ua + ub);
+        case ARITH_SUB:
+            return int_constant(e, ua - ub);
+        case ARITH_MUL:
+            return int_constant(e, ua * ub);
+        default:
+            // idiv traps on these
+            if (b == 0 || (a == LLONG_MIN && b == -1)) {
+                return e;
+            }
+            return int_constant(e, op == ARITH_DIV ? a / b : a % b);
+        }
+    }
+
+    switch (op) {
+    case ARITH_ADD:
+        if (ca && a == 0) return e2;
+        if (cb && b == 0) return e1;
+        break;
+    case ARITH_SUB:
+        if (cb && b == 0) return e1;
+        break;
+    case ARITH_MUL:
+        if (ca && a == 1) return e2;
+        if (cb && b == 1) return e1;
+        if ((ca && a == 0 && e2->is_pure()) || (cb && b == 0 && e1->is_pure())) {
+            return int_constant(e, 0);
+        }
+        break;
+    case ARITH_DIV:
+        if (cb && b == 1) return e1;
+        break;
+    case ARITH_MOD:
+        // not x % -1, which traps when x is LLONG_MIN
+        if (cb && b == 1 && e1->is_pure()) {
+            return int_constant(e, 0);
+        }
+        break;
+    }
+    return e;
+}
+
+static Expr fold_float_arith(Expr e, Arith op, Expr e1, Expr e2) {
+    double a, b;
+    bool ca = number_value(e1, a);
+    bool cb = number_value(e2, b);
+    if (ca && cb) {
+        switch (op) {
+        case ARITH_ADD:
+            return float_constant(e, a + b);
+        case ARITH_SUB:
+            return float_constant(e, a - b);
+        case ARITH_MUL:
+            return float_constant(e, a * b);
+        case ARITH_DIV:
+            return float_constant(e, a / b);
+        default:
+            return e;
+        }
+    }
+
+    // x + -0.0, x - 0.0, x * 1.0 and x / 1.0 are x for every double x,
+    // including -0.0, infinities and NaN
+    bool f1 = e1->getKind() == TYPE_FLOAT;
+    bool f2 = e2->getKind() == TYPE_FLOAT;
+    switch (op) {
+    case ARITH_ADD:
+        if (ca && a == 0 && signbit(a) && f2) return e2;
+        if (cb && b == 0 && signbit(b) && f1) return e1;
+        break;
+    case ARITH_SUB:
+        if (cb && b == 0 && !signbit(b) && f1) return e1;
+        break;
+    case ARITH_MUL:
+        if (ca && a == 1 && f2) return e2;
+        if (cb && b == 1 && f1) return e1;
+        break;
+    case ARITH_DIV:
+        if (cb && b == 1 && f1) return e1;
+        break;
+    default:
+        break;
+    }
+    return e;
+}
+
+static Expr fold_arith(Expr e, Arith op, Expr e1, Expr e2) {
+    switch (e->getKind()) {
+    case TYPE_INT:
+        return fold_int_arith(e, op, e1, e2);
+    case TYPE_FLOAT:
+        return fold_float_arith(e, op, e1, e2);
+    default:
+        return e;
+    }
+}
+
+template <class T> static bool relate(Relation rel, T a, T b) {
+    switch (rel) {
+    case REL_LT: return a < b;
+    case REL_LE: return a <= b;
+    case REL_EQ: return a == b;
+    case REL_NE: return a != b;
+    case REL_GE: return a >= b;
+    default:     return a > b;
+    }
+}
+
+// Int operands compare as Ints, mixed ones as doubles; NaN compares
+// unordered as ucomisd does
+static Expr fold_compare(Expr e, Relation rel, Expr e1, Expr e2) {
+    long long i1, i2;
+    double f1, f2;
+    bool b1, b2;
+    if (e1->int_value(i1) && e2->int_value(i2)) {
+        return bool_constant(e, relate(rel, i1, i2));
+    }
+    if (number_value(e1, f1) && number_value(e2, f2)) {
+        return bool_constant(e, relate(rel, f1, f2));
+    }
+    if (e1->bool_value(b1) && e2->bool_value(b2)) {
+        return bool_constant(e, relate(rel, b1, b2));
+    }
+    return e;
+}
+
+// a branch that can never run
+static StmtBlock empty_block() {
+    return stmtBlock(nil_VariableDecls(), nil_Stmts());
+}
+
+Stmt StmtBlock_class::fold() {
+    for (int i=stmts->first(); stmts->more(i); i=stmts->next(i)) {
+        stmts->nth(i)->fold();
+    }
+    return this;
+}
+
+Stmt IfStmt_class::fold() {
+    condition = condition->fold();
+    thenexpr->fold();
+    elseexpr->fold();
+    bool taken;
+    if (condition->bool_value(taken)) {
+        if (taken) {
+            elseexpr = empty_block();
+        } else {
+            thenexpr = empty_block();
+        }
+    }
+    return this;
+}
+
+Stmt WhileStmt_class::fold() {
+    condition = condition->fold();
+    body->fold();
+    bool taken;
+    if (condition->bool_value(taken) && !taken) {
+        body = empty_block();
+    }
+    return this;
+}
+
+Stmt ForStmt_class::fold() {
+    initexpr = initexpr->fold();
+    condition = condition->fold();
+    loopact = loopact->fold();
+    body->fold();
+    bool taken;
+    if (condition->bool_value(taken) && !taken) {
+        body = empty_block();
+    }
+    return this;
+}
+
+Stmt ReturnStmt_class::fold() {
+    value = value->fold();
+    return this;
+}
+
+Stmt ContinueStmt_class::fold() {
+    return this;
+}
+
+Stmt BreakStmt_class::fold() {
+    return this;
+}
+
+Expr Call_class::fold() {
+    for (int i=actuals->first(); actuals->more(i); i=actuals->next(i)) {
+        actuals->nth(i)->fold();
+    }
+    return this;
+}
+
+Expr Actual_class::fold() {
+    expr = expr->fold();
+    return this;
+}
+
+Expr Assign_class::fold() {
+    value = value->fold();
+    return this;
+}
+
+Expr Add_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_arith(this, ARITH_ADD, e1, e2);
+}
+
+Expr Minus_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_arith(this, ARITH_SUB, e1, e2);
+}
+
+Expr Multi_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_arith(this, ARITH_MUL, e1, e2);
+}
+
+Expr Divide_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_arith(this, ARITH_DIV, e1, e2);
+}
+
+Expr Mod_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_arith(this, ARITH_MOD, e1, e2);
+}
+
+Expr Neg_class::fold() {
+    e1 = e1->fold();
+    long long i;
+    double f;
+    if (e1->int_value(i)) {
+        return int_constant(this, 0 - (unsigned long long) i);
+    }
+    if (e1->float_value(f)) {
+        return float_constant(this, -f);
+    }
+    return this;
+}
+
+Expr Lt_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_compare(this, REL_LT, e1, e2);
+}
+
+Expr Le_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_compare(this, REL_LE, e1, e2);
+}
+
+Expr Equ_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_compare(this, REL_EQ, e1, e2);
+}
+
+Expr Neq_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_compare(this, REL_NE, e1, e2);
+}
+
+Expr Ge_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_compare(this, REL_GE, e1, e2);
+}
+
+Expr Gt_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    return fold_compare(this, REL_GT, e1, e2);
+}
+
+// e2 only runs when e1 is true
+Expr And_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    bool v;
+    if (e1->bool_value(v)) {
+        return v ? e2 : e1;
+    }
+    if (e2->bool_value(v) && (v || e1->is_pure())) {
+        return v ? e1 : e2;
+    }
+    return this;
+}
+
+// e2 only runs when e1 is false
+Expr Or_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    bool v;
+    if (e1->bool_value(v)) {
+        return v ? e1 : e2;
+    }
+    if (e2->bool_value(v) && (!v || e1->is_pure())) {
+        return v ? e2 : e1;
+    }
+    return this;
+}
+
+Expr Xor_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    long long i1, i2;
+    bool b1, b2;
+    if (e1->int_value(i1) && e2->int_value(i2)) {
+        return int_constant(this, i1 ^ i2);
+    }
+    if (e1->bool_value(b1) && e2->bool_value(b2)) {
+        return bool_constant(this, b1 != b2);
+    }
+    return this;
+}
+
+Expr Not_class::fold() {
+    e1 = e1->fold();
+    bool v;
+    if (e1->bool_value(v)) {
+        return bool_constant(this, !v);
+    }
+    return this;
+}
+
+Expr Bitand_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    long long i1, i2;
+    if (e1->int_value(i1) && e2->int_value(i2)) {
+        return int_constant(this, i1 & i2);
+    }
+    return this;
+}
+
+Expr Bitor_class::fold() {
+    e1 = e1->fold();
+    e2 = e2->fold();
+    long long i1, i2;
+    if (e1->int_value(i1) && e2->int_value(i2)) {
+        return int_constant(this, i1 | i2);
+    }
+    return this;
+}
+
+Expr Bitnot_class::fold() {
+    e1 = e1->fold();
+    long long i;
+    if (e1->int_value(i)) {
+        return int_constant(this, ~i);
+    }
+    return this;
+}
+
+Expr Const_int_class::fold() {
+    return this;
+}
+
+Expr Const_string_class::fold() {
+    return this;
+}
+
+Expr Const_float_class::fold() {
+    return this;
+}
+
+Expr Const_bool_class::fold() {
+    return this;
+}
+
+Expr Object_class::fold() {
+    return this;
+}
+
+Expr No_expr_class::fold() {
+    return this;
+}
+
+static void fold_calls(Decls decls) {
+    for (int i=decls->first(); decls->more(i); i=decls->next(i)) {
+        if (decls->nth(i)->isCallDecl()) {
+            ((CallDecl) decls->nth(i))->getBody()->fold();
+        }
+    }
+}
+
 void Program_class::semant() {
     initialize_constants();
     install_calls(decls);
@@ -706,7 +1177,8 @@ void Program_class::semant() {
         cerr << "Compilation halted due to static semantic errors." << endl;
         exit(1);
     }
-}
-
-
 
+    if (cgen_optimize) {
+        fold_calls(decls);
+    }
+}
@@ -5,6 +5,7 @@
 #include "copyright.h"
 
 #include <assert.h>
+#include <stdlib.h>
 #include "stringtab_functions.h"
 #include "stringtab.h"
 
@@ -73,8 +74,26 @@ void dump_Symbol(ostream& s, int n, Symbol sym)
 
 StringEntry::StringEntry(char *s, int l, int i) : Entry(s,l,i) { }
 IdEntry::IdEntry(char *s, int l, int i) : Entry(s,l,i) { }
-IntEntry::IntEntry(char *s, int l, int i) : Entry(s,l,i) { }
-FloatEntry::FloatEntry(char *s, int l, int i) : Entry(s,l,i) { }
+
+//
+// Integer and float constants carry their value, so later phases never
+// parse the string again.  The lexer enters integers in decimal, hex ones
+// past the signed range with a minus sign; the value wraps at 64 bits
+// rather than going through int.
+//
+IntEntry::IntEntry(char *s, int l, int i) : Entry(s,l,i)
+{
+  bool negative = *str == '-';
+  unsigned long long v = 0;
+  for (char *p = str + negative; *p >= '0' && *p <= '9'; p++)
+    v = v * 10 + (*p - '0');
+  value = negative ? -v : v;
+}
+
+FloatEntry::FloatEntry(char *s, int l, int i) : Entry(s,l,i)
+{
+  value = strtod(str, NULL);
+}
 
 IdTable idtable;
 IntTable inttable;
@@ -34,6 +34,7 @@ char *curr_filename = "<stdin>";
 FILE *fin;
 
 extern int omerrs;             // a count of lex and parse errors
+extern int seal_yydebug;       // -p, also reports the tree arena
 
 extern int seal_yyparse();
 void handle_flags(int argc, char *argv[]);
@@ -51,6 +52,9 @@ int main(int argc, char *argv[]) {
 	    exit(1);
     }
     ast_root->dump_with_types(cout,0);
+    if (seal_yydebug)
+	tree_arena.stats(cerr);
+    tree_arena.release();
     fclose(fin);
     return 0;
 }
@@ -657,6 +657,9 @@ char *yytext;
 #include <stringtab.h>
 #include <utilities.h>
 #include <stdint.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <stdlib.h>
 
 /* The compiler assumes these identifiers. */
@@ -669,6 +672,23 @@ char *yytext;
 
 extern FILE *fin; /* we read from this file */
 
+/* fin is scanned straight out of a mapping when it is a regular file,
+ * see seal_lex_switch() at the end of this file.
+ */
+static FILE *scanned_file = NULL;
+static void seal_lex_switch(FILE *f);
+
+/* the string rules match a character at a time and take the rest of
+ * the run along with extend_match(), also at the end of this file
+ */
+static void extend_match(const char *stops, char close);
+
+/* the FILE of the next input may well be the one just closed, so the
+ * mapping is dropped at the end of every file instead
+ */
+#undef yywrap
+#define yywrap() (scanned_file = NULL, 1)
+
 /* define YY_INPUT so we read from the FILE fin:
  * This change makes it possible to use this scanner in
  * the seal compiler.
@@ -690,8 +710,7 @@ extern YYSTYPE seal_yylval;
  *  Add Your own definitions here
  */
 
-char string_const[MAX_STR_CONST];
-int string_const_len;
+std::string string_const;  /* no length limit */
 bool str_contain_null_char;
 
 /*
@@ -945,7 +964,11 @@ YY_DECL
     
 /* %% [7.0] user's declarations go here */
 #line 69 "seal.flex"
-
+  /* a new input file, map it if we can */
+  if (fin != scanned_file) {
+    scanned_file = fin;
+    seal_lex_switch(fin);
+  }
 
 #line 951 "seal-lex.cc"
 
@@ -1333,8 +1356,13 @@ case 47:
 YY_RULE_SETUP
 #line 164 "seal.flex"
 {
-	memset(string_const, 0, sizeof string_const);
-	string_const_len = 0; 
+	/* a literal without escapes is interned straight from the buffer */
+	extend_match("\\\"\n", '"');
+	if (yyleng > 1 && yytext[yyleng - 1] == '"') {
+		seal_yylval.symbol = stringtable.add_string(yytext + 1, yyleng - 2);
+		return (CONST_STRING);
+	}
+	string_const.assign(yytext + 1, yyleng - 1);
 	str_contain_null_char = false;
 	BEGIN QUOTE_STRING;
 }
@@ -1350,20 +1378,16 @@ case 48:
 YY_RULE_SETUP
 #line 176 "seal.flex"
 {
-	if (string_const_len >= MAX_STR_CONST) {
-		strcpy(seal_yylval.error_msg, "String constant too long");
-		BEGIN 0; return (ERROR);
-	} 
 	switch(yytext[1]) {
-		case '\"': string_const[string_const_len++] = '\"'; break;
-		case '\\': string_const[string_const_len++] = '\\'; break;
-		case 'b' : string_const[string_const_len++] = '\b'; break;
-		case 'f' : string_const[string_const_len++] = '\f'; break;
-		case 'n' : string_const[string_const_len++] = '\n'; break;
-		case 't' : string_const[string_const_len++] = '\t'; break;
-		case '0' : string_const[string_const_len++] = '\0'; 
+		case '\"': string_const += '\"'; break;
+		case '\\': string_const += '\\'; break;
+		case 'b' : string_const += '\b'; break;
+		case 'f' : string_const += '\f'; break;
+		case 'n' : string_const += '\n'; break;
+		case 't' : string_const += '\t'; break;
+		case '0' : string_const += '\0'; 
 			   str_contain_null_char = true; break;
-		default  : string_const[string_const_len++] = yytext[1];
+		default  : string_const += yytext[1];
 	}
 }
 	YY_BREAK
@@ -1372,11 +1396,7 @@ case 49:
 YY_RULE_SETUP
 #line 194 "seal.flex"
 { 
-	if (string_const_len >= MAX_STR_CONST) {
-		strcpy(seal_yylval.error_msg, "String constant too long");
-		BEGIN 0; return (ERROR);
-	} 
-	string_const[string_const_len++] = '\n'; 
+	string_const += '\n'; 
 	curr_lineno++; 
 	}
 	YY_BREAK
@@ -1394,31 +1414,32 @@ case 51:
 YY_RULE_SETUP
 #line 208 "seal.flex"
 { 
-	if (string_const_len > 0 && str_contain_null_char) {
+	if (!string_const.empty() && str_contain_null_char) {
 		strcpy(seal_yylval.error_msg, "String contains null character \'\\0\'");
 		BEGIN 0; return (ERROR);
 	}
-	seal_yylval.symbol = stringtable.add_string(string_const);
+	seal_yylval.symbol = stringtable.add_string((char *) string_const.data(), string_const.size());
 	BEGIN 0; return (CONST_STRING);
 }
 	YY_BREAK
 case 52:
 YY_RULE_SETUP
 #line 217 "seal.flex"
-{ 
-	if (string_const_len >= MAX_STR_CONST) {
-		strcpy(seal_yylval.error_msg, "String constant too long");
-		BEGIN 0; return (ERROR);
-	} 
-	string_const[string_const_len++] = yytext[0]; 
+{
+	extend_match("\\\"\n", '\0');
+	string_const.append(yytext, yyleng);
 }
 	YY_BREAK
 case 53:
 YY_RULE_SETUP
 #line 225 "seal.flex"
 {
-	memset(string_const, 0, sizeof string_const);
-	string_const_len = 0; 
+	extend_match("`", '`');
+	if (yyleng > 1 && yytext[yyleng - 1] == '`') {
+		seal_yylval.symbol = stringtable.add_string(yytext + 1, yyleng - 2);
+		return (CONST_STRING);
+	}
+	string_const.assign(yytext + 1, yyleng - 1);
 	BEGIN REVERSE_STRING;
 }
 	YY_BREAK
@@ -1427,34 +1448,24 @@ case 54:
 YY_RULE_SETUP
 #line 231 "seal.flex"
 {
-	if (string_const_len >= MAX_STR_CONST) {
-		strcpy(seal_yylval.error_msg, "String constant too long");
-		BEGIN 0; return (ERROR);
-	} 
 	curr_lineno++;
-	string_const[string_const_len++] = yytext[0]; 
+	extend_match("`", '\0');
+	string_const.append(yytext, yyleng);
 }
 	YY_BREAK
 case 55:
 YY_RULE_SETUP
 #line 240 "seal.flex"
 {
-	if (string_const_len >= MAX_STR_CONST) {
-		strcpy(seal_yylval.error_msg, "String constant too long");
-		BEGIN 0; return (ERROR);
-	} 
-	string_const[string_const_len++] = yytext[0]; 
+	extend_match("`", '\0');
+	string_const.append(yytext, yyleng);
 }
 	YY_BREAK
 case 56:
 YY_RULE_SETUP
 #line 248 "seal.flex"
 {
-	if (string_const_len >= MAX_STR_CONST) {
-		strcpy(seal_yylval.error_msg, "String constant too long");
-		BEGIN 0; return (ERROR);
-	} 
-	seal_yylval.symbol = stringtable.add_string(string_const);
+	seal_yylval.symbol = stringtable.add_string((char *) string_const.data(), string_const.size());
 	BEGIN 0; return (CONST_STRING);
 }
 	YY_BREAK
@@ -1480,21 +1491,17 @@ case 58:
 YY_RULE_SETUP
 #line 271 "seal.flex"
 {
-	long r = 0;
-	for(int i = yyleng - 1, p = 1; i >= 2; i--) {
+	unsigned long long r = 0;
+	for(yy_size_t i = 2; i < yyleng; i++) {
 		if(yytext[i] >= 'a') {
-			r += (yytext[i] - 'a' + 10) * p;
+			r = r * 16 + (yytext[i] - 'a' + 10);
 		} else if (yytext[i] >= 'A') {
-			r += (yytext[i] - 'A' + 10) * p;
+			r = r * 16 + (yytext[i] - 'A' + 10);
 		} else {
-			r += (yytext[i] - '0') * p;
+			r = r * 16 + (yytext[i] - '0');
 		}
-		
-		p *= 16;
 	}
-	char *s = new char[20];
-	sprintf(s, "%ld", r);
-	seal_yylval.symbol = inttable.add_string(s); 
+	seal_yylval.symbol = inttable.add_int(r); 
 	return (CONST_INT);
 }
 	YY_BREAK
@@ -2665,5 +2672,67 @@ void yyfree (void * ptr )
 
 #line 314 "seal.flex"
 
+static char *mapped_base = NULL;
+static size_t mapped_size = 0;
 
+/*
+ * Hand flex the whole file without copying it.  yy_scan_buffer wants two
+ * NUL bytes after the text and flex writes into its buffer, so the file
+ * is mapped copy-on-write over a zero-filled anonymous region that has
+ * room for them.  Pipes, terminals and empty files keep going through
+ * YY_INPUT.
+ */
+static void seal_lex_switch(FILE *f)
+{
+  bool had_buffer = YY_CURRENT_BUFFER != NULL;
+  if (had_buffer)
+    yy_delete_buffer(YY_CURRENT_BUFFER);
+  if (mapped_base != NULL) {
+    munmap(mapped_base, mapped_size);
+    mapped_base = NULL;
+  }
+
+  struct stat st;
+  if (f != NULL && fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    size_t len = st.st_size;
+    mapped_size = len + 2;
+    void *base = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base != MAP_FAILED &&
+        mmap(base, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+             fileno(f), 0) != MAP_FAILED) {
+      mapped_base = (char *) base;
+      yy_scan_buffer(mapped_base, mapped_size);
+      return;
+    }
+    if (base != MAP_FAILED)
+      munmap(base, mapped_size);
+  }
 
+  if (had_buffer)
+    yy_switch_to_buffer(yy_create_buffer(f, YY_BUF_SIZE));
+}
+
+/*
+ * Go on matching from the end of yytext up to the first of stops, or up
+ * to the NUL that flex keeps after the text it has read in, and past
+ * that stop too when it is close.  yytext and yyleng then cover the whole
+ * run and the rules carry on where it ends, so a string costs one action
+ * per run of plain characters instead of one per character.
+ */
+static void extend_match(const char *stops, char close)
+{
+  char *run = yy_c_buf_p;
+  *run = yy_hold_char;
+  char *end = run + strcspn(run, stops);
+  if (close != '\0' && *end == close)
+    end++;
+  for (char *p = run; p != end; p++)
+    if (*p == '\n')
+      curr_lineno++;
+
+  yy_hold_char = *end;
+  *end = '\0';
+  yy_c_buf_p = end;
+  yyleng += end - run;
+}
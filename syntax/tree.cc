@@ -13,6 +13,11 @@
 //
 ///////////////////////////////////////////////////////////////////////////
 
+#include <stdlib.h>
+#include <typeinfo>
+#include <cxxabi.h>
+#include <map>
+#include <string>
 #include "tree.h"
 
 /* line number to assign to the current node being constructed */
@@ -47,3 +52,125 @@ tree_node *tree_node::set(tree_node *t) {
    line_number = t->line_number;
    return this;
 }
+
+///////////////////////////////////////////////////////////////////////////
+//
+// NodeArena
+//
+// Nodes are carved out of chunks of CHUNK_SIZE bytes, larger ones get a
+// chunk of their own.  Each node is preceded by a NodeHeader with its
+// size, so release() and stats() can walk the nodes of a chunk in order.
+// A node deleted on its own is only marked dead; its memory goes back
+// with the rest of the arena.
+//
+///////////////////////////////////////////////////////////////////////////
+
+NodeArena tree_arena;
+
+struct NodeHeader {
+    size_t size;                // of the node, rounded up to NODE_ALIGN
+    size_t live;
+};
+
+static const size_t NODE_ALIGN = 16;
+static const size_t CHUNK_SIZE = 64 * 1024;
+
+static size_t align_up(size_t n)
+{
+    return (n + NODE_ALIGN - 1) & ~(NODE_ALIGN - 1);
+}
+
+char *NodeArena::data(Chunk *c)
+{
+    return (char *) c + align_up(sizeof(Chunk));
+}
+
+NodeArena::Chunk *NodeArena::new_chunk(size_t size)
+{
+    Chunk *c = (Chunk *) malloc(align_up(sizeof(Chunk)) + size);
+    if (c == NULL) {
+	cerr << "out of memory for the syntax tree\n";
+	exit(1);
+    }
+    c->next = NULL;
+    c->size = size;
+    c->used = 0;
+    return c;
+}
+
+void *NodeArena::allocate(size_t size)
+{
+    size_t need = sizeof(NodeHeader) + align_up(size);
+    Chunk *c = chunks;
+    if (c == NULL || c->used + need > c->size) {
+	if (need > CHUNK_SIZE && c != NULL) {
+	    // keep filling the current chunk afterwards
+	    Chunk *big = new_chunk(need);
+	    big->next = c->next;
+	    c->next = big;
+	    c = big;
+	} else {
+	    c = new_chunk(need > CHUNK_SIZE ? need : CHUNK_SIZE);
+	    c->next = chunks;
+	    chunks = c;
+	}
+    }
+
+    NodeHeader *h = (NodeHeader *) (data(c) + c->used);
+    h->size = align_up(size);
+    h->live = 1;
+    c->used += need;
+    bytes += need;
+    nodes++;
+    return h + 1;
+}
+
+void NodeArena::free(void *p)
+{
+    if (p != NULL)
+	((NodeHeader *) p - 1)->live = 0;
+}
+
+void NodeArena::release()
+{
+    while (chunks) {
+	Chunk *c = chunks;
+	chunks = c->next;
+	char *start = data(c);
+	for (size_t off = 0; off < c->used; ) {
+	    NodeHeader *h = (NodeHeader *) (start + off);
+	    if (h->live)
+		((tree_node *) (h + 1))->~tree_node();
+	    off += sizeof(NodeHeader) + h->size;
+	}
+	::free(c);
+    }
+    bytes = 0;
+    nodes = 0;
+}
+
+void NodeArena::stats(ostream& s)
+{
+    std::map<std::string, int> classes;
+    int nchunks = 0;
+    for (Chunk *c = chunks; c; c = c->next) {
+	nchunks++;
+	char *start = data(c);
+	for (size_t off = 0; off < c->used; ) {
+	    NodeHeader *h = (NodeHeader *) (start + off);
+	    if (h->live) {
+		const char *name = typeid(*(tree_node *) (h + 1)).name();
+		int status;
+		char *readable = abi::__cxa_demangle(name, NULL, NULL, &status);
+		classes[status == 0 ? readable : name]++;
+		::free(readable);
+	    }
+	    off += sizeof(NodeHeader) + h->size;
+	}
+    }
+
+    s << "Tree arena: " << bytes << " bytes in " << nchunks << " chunks, "
+      << nodes << " nodes" << endl;
+    for (std::map<std::string, int>::iterator i = classes.begin(); i != classes.end(); i++)
+	s << "  " << i->second << " " << i->first << endl;
+}